@@ -10,47 +10,246 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <ctime>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <cfloat>
+#include <climits>
+#include <tuple>
+#include <zlib.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Shader sources
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec3 aPos;
     layout (location = 1) in vec3 aNormal;
+    layout (location = 2) in vec4 aTexCoord;
+    
+    out vec3 FragPos;
+    out vec3 Normal;
+    out vec4 TexCoord;
+    flat out uint CornerIndex;
+    noperspective out vec2 Barycentric;
+    
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec4 sectionPlanes[6];
+    
+    out float gl_ClipDistance[6];
+    
+    void main() {
+        CornerIndex = uint(gl_VertexID);
+        Barycentric = vec2(gl_VertexID % 3 == 0, gl_VertexID % 3 == 1);
+        FragPos = vec3(model * vec4(aPos, 1.0));
+        Normal = mat3(transpose(inverse(model))) * aNormal;
+        TexCoord = aTexCoord;
+        gl_Position = projection * view * model * vec4(aPos, 1.0);
+        for (int i = 0; i < 6; i++) {
+            gl_ClipDistance[i] = dot(sectionPlanes[i], vec4(aPos, 1.0));
+        }
+    }
+)";
+
+// Octahedral normal encoding, the GLSL side of encodeOctahedral/decodeOctahedral, inserted
+// into the shaders that read compressed normals or pick impostor views
+const char* octahedralShaderSource = R"(
+    vec2 encodeOctahedral(vec3 n) {
+        n /= abs(n.x) + abs(n.y) + abs(n.z);
+        vec2 e = n.xy;
+        if (n.z < 0.0) {
+            e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        }
+        return e;
+    }
+
+    vec3 decodeOctahedral(vec2 e) {
+        vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+        if (n.z < 0.0) {
+            n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+        }
+        return normalize(n);
+    }
+)";
+
+// Vertex-pulling variant: attributes are fetched from texture buffers with gl_VertexID.
+// Each corner stores an index into deduplicated vertices whose positions are 16-bit
+// relative to the batch bounds and whose normals are 16-bit octahedral.
+const char* pullingVertexShaderSource = R"(
+    #version 330 core
+    uniform usamplerBuffer vertexIndices;
+    uniform samplerBuffer positions;
+    uniform samplerBuffer encodedNormals;
+    uniform vec3 positionOrigin;
+    uniform vec3 positionExtent;
+    uniform bool hasNormals;
     
     out vec3 FragPos;
     out vec3 Normal;
+    out vec4 TexCoord;
+    flat out uint CornerIndex;
+    noperspective out vec2 Barycentric;
     
     uniform mat4 model;
     uniform mat4 view;
     uniform mat4 projection;
+    uniform vec4 sectionPlanes[6];
+    
+    out float gl_ClipDistance[6];
     
     void main() {
+        CornerIndex = uint(gl_VertexID);
+        Barycentric = vec2(gl_VertexID % 3 == 0, gl_VertexID % 3 == 1);
+        int index = int(texelFetch(vertexIndices, gl_VertexID).r);
+        vec3 aPos = positionOrigin + texelFetch(positions, index).xyz * positionExtent;
+        vec3 aNormal = hasNormals ? decodeOctahedral(texelFetch(encodedNormals, index).xy * 2.0 - 1.0) : vec3(0.0);
+
         FragPos = vec3(model * vec4(aPos, 1.0));
         Normal = mat3(transpose(inverse(model))) * aNormal;
+        TexCoord = vec4(0.0, 0.0, 0.0, 1.0);
         gl_Position = projection * view * model * vec4(aPos, 1.0);
+        for (int i = 0; i < 6; i++) {
+            gl_ClipDistance[i] = dot(sectionPlanes[i], vec4(aPos, 1.0));
+        }
     }
 )";
 
 const char* fragmentShaderSource = R"(
     #version 330 core
-    out vec4 FragColor;
+    layout (location = 0) out vec4 FragColor;
+    layout (location = 1) out vec4 TransparencyWeight;
     
     in vec3 FragPos;
     in vec3 Normal;
+    in vec4 TexCoord;
     
     uniform vec3 viewPos;
     uniform vec3 lightDir;
     uniform vec3 materialColor;
+    uniform bool flatShading;
+    uniform bool transparencyPass;
+    
+    // Material textures: TexCoord.z selects the layer, TexCoord.w is the material opacity
+    uniform sampler2DArray materialTextures;
+    uniform bool textured;
+    
+    // Virtual texture: the page table maps each page of each mip level to a tile of the
+    // tile cache, or to the tile of its nearest resident ancestor
+    uniform bool virtualTextured;
+    uniform usampler2D pageTable;
+    uniform sampler2D tileCache;
+    uniform ivec2 virtualSize;
+    uniform int virtualLevels;
+    uniform int pageRows[16];
+    
+    const float pageSize = 128.0;
+    const float pageBorder = 4.0;
+    
+    // Directional shadow map; shadowMatrix takes world positions to its texture
+    // coordinates and depth
+    uniform bool shadowed;
+    uniform sampler2DShadow shadowMap;
+    uniform mat4 shadowMatrix;
+    
+    float shadowFactor() {
+        if (!shadowed) return 1.0;
+        vec3 coord = (shadowMatrix * vec4(FragPos, 1.0)).xyz;
+        if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) return 1.0;
+        
+        // Four filtered taps half a texel apart
+        vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0));
+        float lit = 0.0;
+        for (int i = 0; i < 4; i++) {
+            vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+            lit += texture(shadowMap, vec3(coord.xy + offset, coord.z));
+        }
+        return lit * 0.25;
+    }
+    
+    vec3 sampleVirtual(vec2 uv) {
+        vec2 texel = uv * vec2(virtualSize);
+        float lod = log2(max(length(dFdx(texel)), length(dFdy(texel))));
+        int level = int(clamp(lod, 0.0, float(virtualLevels - 1)));
+        vec2 wrapped = fract(uv);
+        ivec2 page = ivec2(wrapped * vec2(max(virtualSize >> level, 1)) / pageSize);
+        uvec4 entry = texelFetch(pageTable, ivec2(page.x, pageRows[level] + page.y), 0);
+        if (entry.a == 0u) return materialColor;
+        
+        vec2 residentTexel = wrapped * vec2(max(virtualSize >> int(entry.b), 1));
+        vec2 inPage = residentTexel - floor(residentTexel / pageSize) * pageSize;
+        vec2 cacheTexel = vec2(entry.rg) * (pageSize + 2.0 * pageBorder) + pageBorder + inPage;
+        return textureLod(tileCache, cacheTexel / vec2(textureSize(tileCache, 0)), 0.0).rgb;
+    }
+    
+#if defined(MATCAP)
+    // Lit sphere indexed by the view-space normal: gamma-encoded diffuse light in rgb,
+    // specular in alpha
+    uniform mat4 view;
+    uniform sampler2D matcap;
+#elif defined(SPHERICAL_HARMONICS)
+    // Irradiance of the environment as 9 spherical harmonic coefficients (L00, L1-1, L10,
+    // L11, L2-2, L2-1, L20, L21, L22)
+    uniform vec3 shCoefficients[9];
+    
+    vec3 irradiance(vec3 n) {
+        const float c1 = 0.429043, c2 = 0.511664, c3 = 0.743125, c4 = 0.886227, c5 = 0.247708;
+        return c1 * shCoefficients[8] * (n.x * n.x - n.y * n.y) + c3 * shCoefficients[6] * n.z * n.z
+             + c4 * shCoefficients[0] - c5 * shCoefficients[6]
+             + 2.0 * c1 * (shCoefficients[4] * n.x * n.y + shCoefficients[7] * n.x * n.z + shCoefficients[5] * n.y * n.z)
+             + 2.0 * c2 * (shCoefficients[3] * n.x + shCoefficients[1] * n.y + shCoefficients[2] * n.z);
+    }
+#endif
     
     void main() {
-        // Normalize normal vector
-        vec3 norm = normalize(Normal);
+        // Normalize normal vector, or derive the face normal from screen-space derivatives
+        vec3 norm = flatShading ? normalize(cross(dFdx(FragPos), dFdy(FragPos))) : normalize(Normal);
         
         // Base color
         vec3 baseColor = materialColor;
+        float alpha = TexCoord.w;
+        if (virtualTextured) {
+            baseColor = sampleVirtual(TexCoord.xy);
+        } else if (textured) {
+            vec4 texel = texture(materialTextures, TexCoord.xyz);
+            baseColor = texel.rgb;
+            alpha *= texel.a;
+        }
+        
+        // Transparent surfaces are drawn without culling and lit from both sides
+        if (transparencyPass && !flatShading && !gl_FrontFacing) {
+            norm = -norm;
+        }
         
+#if defined(MATCAP)
+        // One fetch; the square root stands in for the display gamma
+        vec4 lit = texture(matcap, normalize(mat3(view) * norm).xy * 0.5 + 0.5);
+        vec3 result = sqrt(baseColor) * lit.rgb + lit.a;
+#elif defined(SPHERICAL_HARMONICS)
+        vec3 result = sqrt(baseColor * max(irradiance(norm), vec3(0.0)));
+#else
         // Ambient lighting
         float ambientStrength = 0.3;
         vec3 ambient = ambientStrength * baseColor;
@@ -68,492 +267,7863 @@ const char* fragmentShaderSource = R"(
         vec3 specular = specularStrength * spec * vec3(1.0);
         
         // Final color
-        vec3 result = ambient + diffuse + specular;
+        vec3 result = ambient + shadowFactor() * (diffuse + specular);
         
         // Apply gamma correction
         result = pow(result, vec3(1.0/2.2));
+#endif
         
-        FragColor = vec4(result, 1.0);
+        // Weighted blended transparency: premultiplied color and coverage go to additive
+        // targets with a weight favouring near, opaque fragments; alpha blending of the
+        // first target's alpha accumulates the revealed background
+        if (transparencyPass) {
+            float z = 1.0 - gl_FragCoord.z * 0.9;
+            float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * z * z * z, 1e-2, 3e3);
+            FragColor = vec4(result * alpha * weight, alpha);
+            TransparencyWeight = vec4(alpha * weight);
+        } else {
+            FragColor = vec4(result, 1.0);
+        }
     }
 )";
 
-// Camera variables
-glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
-glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-
-// Mouse control variables
-float lastX = 400.0f;
-float lastY = 300.0f;
-bool firstMouse = true;
-bool mousePressed = false;
-float zoom = 45.0f;
-
-// Object rotation variables
-float rotationX = 0.0f;
-float rotationY = 0.0f;
-
-// Rendering settings
-bool showWireframe = false;
-
-// Light and material settings
-glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
-glm::vec3 materialColor = glm::vec3(0.9f, 0.9f, 0.95f);
-
-// Function prototypes
-GLuint compileShaders();
-bool loadOBJ(const char* path, 
-             std::vector<glm::vec3>& out_vertices, 
-             std::vector<glm::vec3>& out_normals, 
-             std::vector<glm::vec2>& out_uvs);
-void calculateSmoothNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals);
-
-// Callback functions
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-
-int main(int argc, char* argv[]) {
-    // Check if OBJ file path is provided
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <path_to_obj_file>" << std::endl;
-        return -1;
+// Resolve of the weighted blended transparency targets over the opaque image, drawn as a
+// full-screen triangle
+const char* transparencyResolveVertexShaderSource = R"(
+    #version 330 core
+    void main() {
+        vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
     }
+)";
 
-    const char* objFilePath = argv[1];
-
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
+const char* transparencyResolveFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    uniform sampler2D accumulation;
+    uniform sampler2D weights;
+    
+    void main() {
+        ivec2 pixel = ivec2(gl_FragCoord.xy);
+        vec4 accumulated = texelFetch(accumulation, pixel, 0);
+        float revealage = accumulated.a;
+        if (revealage >= 1.0) discard;
+        
+        float weight = texelFetch(weights, pixel, 0).r;
+        FragColor = vec4(accumulated.rgb / max(weight, 1e-5), 1.0 - revealage);
     }
+)";
 
-    // Configure GLFW
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 8); // Enable high-quality anti-aliasing
+// Feature and silhouette lines, pulled slightly towards the camera so they win the depth
+// test against the surface they lie on
+const char* edgeFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    uniform vec3 edgeColor;
+    
+    void main() {
+        gl_FragDepth = gl_FragCoord.z - 2e-5;
+        FragColor = vec4(edgeColor, 1.0);
+    }
+)";
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(1200, 800, "OBJ Viewer", NULL, NULL);
-    if (window == NULL) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+// Silhouette candidates: every edge between two faces, with 16-bit positions relative to
+// the edge bounds and both face normals octahedral-encoded. The geometry shader keeps the
+// edges whose faces point to different sides of the camera.
+const char* silhouetteVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in vec4 aFaceNormals;
+    
+    uniform vec3 positionOrigin;
+    uniform vec3 positionExtent;
+    
+    out vec3 EdgePos;
+    out vec4 FaceNormals;
+    
+    void main() {
+        EdgePos = positionOrigin + aPos * positionExtent;
+        FaceNormals = aFaceNormals;
     }
+)";
 
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-    glfwSetKeyCallback(window, key_callback);
+const char* silhouetteGeometryShaderSource = R"(
+    #version 330 core
+    layout (lines) in;
+    layout (line_strip, max_vertices = 2) out;
+    
+    in vec3 EdgePos[];
+    in vec4 FaceNormals[];
+    
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec3 modelCamera;
+    uniform vec4 sectionPlanes[6];
+    
+    out float gl_ClipDistance[6];
+    
+    void main() {
+        vec3 toCamera = modelCamera - 0.5 * (EdgePos[0] + EdgePos[1]);
+        float facing0 = dot(decodeOctahedral(FaceNormals[0].xy), toCamera);
+        float facing1 = dot(decodeOctahedral(FaceNormals[0].zw), toCamera);
+        if (facing0 * facing1 > 0.0) return;
+        
+        for (int i = 0; i < 2; i++) {
+            gl_Position = projection * view * model * vec4(EdgePos[i], 1.0);
+            for (int p = 0; p < 6; p++) {
+                gl_ClipDistance[p] = dot(sectionPlanes[p], vec4(EdgePos[i], 1.0));
+            }
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+)";
 
-    // Initialize GLEW
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW" << std::endl;
-        return -1;
+// Picking: the 1-based index of the triangle covering each pixel, from the corner index the
+// scene vertex shaders pass on (the batch's local gl_VertexID)
+const char* pickFragmentShaderSource = R"(
+    #version 330 core
+    flat in uint CornerIndex;
+    out uint PickId;
+    
+    uniform uint batchFirstTriangle;
+    
+    void main() {
+        PickId = batchFirstTriangle + CornerIndex / 3u + 1u;
     }
+)";
 
-    // Print basic controls to console
-    std::cout << "========== OBJ Viewer Controls ==========\n";
-    std::cout << "Mouse Drag: Rotate model\n";
-    std::cout << "Scroll: Zoom in/out\n";
-    std::cout << "W: Toggle wireframe\n";
-    std::cout << "Esc: Exit\n";
-    std::cout << "========================================\n";
+// The debug views' color scale, inserted into both of their fragment shaders: dark blue
+// through cyan, yellow and red for t in [0, 1]
+const char* heatMapShaderSource = R"(
+    vec3 heat(float t) {
+        t = clamp(t, 0.0, 1.0);
+        return clamp(vec3(1.5 - abs(4.0 * t - 3.0), 1.5 - abs(4.0 * t - 2.0), 1.5 - abs(4.0 * t - 1.0)), 0.0, 1.0);
+    }
+)";
 
-    // Compile shaders
-    GLuint shaderProgram = compileShaders();
-    if (shaderProgram == 0) {
-        return -1;
+// Debug views (cycled with D). Overdraw and fragment cost write 1 per fragment, added up in
+// a float target and resolved to a heat map; triangle density and index order are colored
+// directly.
+const char* debugViewFragmentShaderSource = R"(
+    #version 330 core
+    flat in uint CornerIndex;
+    noperspective in vec2 Barycentric;
+    out vec4 FragColor;
+    
+    uniform int debugMode;
+    uniform uint batchFirstTriangle;
+    uniform float triangleCount;
+    
+    void main() {
+        if (debugMode == 2) {
+            // The barycentrics change by 1 across the triangle, so the determinant of their
+            // screen-space derivatives is one over twice its area in pixels. 1/1024 triangles
+            // per pixel is blue, 1 or more red.
+            float inverseArea = 2.0 * abs(dFdx(Barycentric).x * dFdy(Barycentric).y - dFdy(Barycentric).x * dFdx(Barycentric).y);
+            FragColor = vec4(heat(log2(max(inverseArea, 1e-6)) / 10.0 + 1.0), 1.0);
+        } else if (debugMode == 3) {
+            FragColor = vec4(heat(float(batchFirstTriangle + CornerIndex / 3u) / triangleCount), 1.0);
+        } else {
+            FragColor = vec4(1.0);
+        }
     }
+)";
 
-    // Load OBJ file
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> uvs;
+// Fragment counts as a heat map: none black, 1 dark blue, debugViewMaxCount or more red
+const char* debugViewResolveFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    uniform sampler2D counts;
+    uniform float maxCount;
+    
+    void main() {
+        float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;
+        FragColor = vec4(count < 0.5 ? vec3(0.0) : heat((count - 1.0) / (maxCount - 1.0)), 1.0);
+    }
+)";
 
-    std::cout << "Loading OBJ file: " << objFilePath << std::endl;
-    if (!loadOBJ(objFilePath, vertices, normals, uvs)) {
-        std::cerr << "Failed to load OBJ file: " << objFilePath << std::endl;
-        return -1;
+// Section caps: a quad in the section plane, clipped by the other planes and drawn where
+// the stencil marks the inside of the model
+const char* sectionCapVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec4 sectionPlanes[6];
+    
+    out float gl_ClipDistance[6];
+    
+    void main() {
+        gl_Position = projection * view * model * vec4(aPos, 1.0);
+        for (int i = 0; i < 6; i++) {
+            gl_ClipDistance[i] = dot(sectionPlanes[i], vec4(aPos, 1.0));
+        }
     }
-    std::cout << "OBJ file loaded successfully. Vertices: " << vertices.size() << std::endl;
+)";
 
-    // Calculate smooth normals if none provided
-    if (normals.empty() || normals.size() != vertices.size()) {
-        normals.clear();
-        normals.resize(vertices.size(), glm::vec3(0.0f));
-        calculateSmoothNormals(vertices, normals);
+const char* sectionCapFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    uniform vec3 capColor;
+    uniform vec3 capNormal;
+    uniform vec3 lightDir;
+    
+    void main() {
+        float diffuse = max(dot(capNormal, normalize(lightDir)), 0.0);
+        FragColor = vec4(pow(capColor * (0.3 + 0.7 * diffuse), vec3(1.0/2.2)), 1.0);
     }
+)";
 
-    // Prepare data for GPU
-    GLuint VAO, VBO, NBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &NBO);
+// Read-only memory mapping of a whole file
+struct MappedFile {
+    const char* data = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
 
-    glBindVertexArray(VAO);
+// One file of a zip archive, from its central directory record
+struct ZipEntry {
+    std::string name;
+    uint16_t flags = 0;
+    uint16_t method = 0;
+    uint64_t compressedSize = 0;
+    uint64_t size = 0;
+    uint64_t localHeaderOffset = 0;
+};
 
-    // Position attribute
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+// Memory-mapped zip archive; entries are read straight out of the mapping
+struct ZipArchive {
+    MappedFile file;
+    std::vector<ZipEntry> entries;
+    std::map<std::string, size_t> byName;
+};
 
-    // Normal attribute
-    glBindBuffer(GL_ARRAY_BUFFER, NBO);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(1);
+// Raw bytes of an asset, pointing either into a mapping (zero-copy) or into `storage`
+struct AssetData {
+    const char* data = NULL;
+    size_t size = 0;
+    std::vector<char> storage;
+};
 
-    // Calculate center and scale for model
-    glm::vec3 center(0.0f);
-    float maxDistance = 0.0f;
+// Bounded-size slice of the mesh with its own buffers, uploaded and drawn independently
+struct MeshBatch {
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    GLuint NBO = 0;
+    GLuint WBO = 0;     // weld ids for GPU normal generation, deleted once normals exist
+    GLuint TBO = 0;     // texture coordinates with the material layer
+    size_t first = 0;   // first corner of the batch in the CPU arrays
+    GLsizei count = 0;  // corners in the batch, a multiple of 3
+    bool uploaded = false;
 
-    for (const auto& vertex : vertices) {
-        center += vertex;
-    }
-    center /= vertices.size();
+    // Vertex pulling: VBO/NBO hold deduplicated quantized vertices, IBO the per-corner
+    // indices, each exposed through a buffer texture
+    GLuint IBO = 0;
+    GLuint textures[3] = {0, 0, 0};
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 extent = glm::vec3(0.0f);
 
-    for (const auto& vertex : vertices) {
-        float distance = glm::length(vertex - center);
-        if (distance > maxDistance) {
-            maxDistance = distance;
-        }
-    }
+    // Feature edges: pairs of local corner indices drawn as GL_LINES
+    GLuint EBO = 0;
+    GLsizei edgeCount = 0;
+};
 
-    // Enable depth testing and multisampling
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
-    
-    // Enable backface culling
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    
-    // Smooth line rendering for wireframe
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    
-    // Background color (dark gray)
-    glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+// Silhouette candidate edge endpoint: position normalized to the edge bounds, and the
+// octahedral normals of the edge's two faces
+struct SilhouetteVertex {
+    uint16_t position[4];
+    int16_t faceNormals[4];
+};
 
-    // Main render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Clear buffers
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// Run of silhouette candidates that are close together: bounding sphere of the edges and
+// the cone (axis, half-angle) containing their face normals. From a camera position where
+// no normal of the cone can be edge-on, none of the edges is a silhouette.
+struct EdgeCluster {
+    glm::vec4 sphere = glm::vec4(0.0f);
+    glm::vec3 axis = glm::vec3(0.0f);
+    float coneAngle = 0.0f;
+    GLint first = 0;    // first vertex, two per edge
+    GLsizei count = 0;
+};
 
-        // Use shader program
-        glUseProgram(shaderProgram);
+// Bounds of sectionClusterCorners consecutive corners, for skipping the runs of the mesh
+// that a section plane removes entirely
+struct SectionCluster {
+    glm::vec3 minBound = glm::vec3(0.0f);
+    glm::vec3 maxBound = glm::vec3(0.0f);
+};
 
-        // Set uniform values
-        GLint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
-        GLint lightDirLoc = glGetUniformLocation(shaderProgram, "lightDir");
-        GLint materialColorLoc = glGetUniformLocation(shaderProgram, "materialColor");
-        
-        GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-        GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+// Cluster of the continuous LOD hierarchy, drawn as a unit. `bounds` and `error` belong to
+// the group simplification that produced the cluster (zero error at full detail), the
+// parent fields to the one that replaced it (FLT_MAX for roots).
+struct LODCluster {
+    size_t firstCorner = 0;
+    uint32_t cornerCount = 0;
+    uint32_t level = 0;
+    uint32_t buffer = 0;        // LODBuffer holding the cluster's corners
+    glm::vec4 cullBounds = glm::vec4(0.0f);
+    glm::vec4 bounds = glm::vec4(0.0f);
+    float error = 0.0f;
+    glm::vec4 parentBounds = glm::vec4(0.0f);
+    float parentError = FLT_MAX;
+};
 
-        glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
-        glUniform3fv(lightDirLoc, 1, glm::value_ptr(lightDir));
-        glUniform3fv(materialColorLoc, 1, glm::value_ptr(materialColor));
+// All levels of the hierarchy as one triangle soup; the first `baseCorners` corners are
+// the full-detail mesh
+struct LODMesh {
+    std::vector<LODCluster> clusters;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    size_t baseCorners = 0;
+};
 
-        // Create transformations
-        glm::mat4 model = glm::mat4(1.0f);
+// Intersection of the mesh with one slicing plane: polylines in the plane's other two
+// coordinates, closed where they go around the surface
+struct SlicePolyline {
+    std::vector<glm::vec2> points;
+    bool closed = false;
+};
+
+struct MeshSlice {
+    float height = 0.0f;    // coordinate of the plane along the slicing axis
+    std::vector<SlicePolyline> polylines;
+};
+
+// Model of a thumbnail run: its mesh until the page it is on has been uploaded, and its
+// corner range in the page's shared buffers
+struct Thumbnail {
+    std::string path;
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 1.0f;
+    bool loaded = false;
+    GLint first = 0;
+};
+
+// Object (`o` record) of the loaded mesh: its corner range, model-space bounding sphere
+// and, once baked, the layer of its impostor in the impostor atlas array
+struct SceneObject {
+    std::string name;
+    size_t first = 0;
+    size_t count = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    int layer = -1;
+    bool baked = false;
+};
+
+// Decoded 8-bit RGBA image, first row at the top
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Material of an MTL library; `texture` indexes `materialTextures`
+struct Material {
+    std::string name;
+    glm::vec3 diffuse = glm::vec3(0.8f);
+    std::string diffuseMap;     // resolved path of `map_Kd`
+    float opacity = 1.0f;       // `d`, or 1 - `Tr`
+    int texture = -1;
+};
+
+// Texture shared by materials, stored as one layer of a material texture array. Materials
+// without a usable `map_Kd` get a 1x1 `solid` texture of their diffuse color. Textures are
+// kept either decoded in `image` or as a compressed mip chain in `levels`.
+struct MaterialTexture {
+    std::string path;
+    uint64_t sourceHash = 0;    // hash of the file contents, the compressed cache key
+    Image image;                // freed after upload; only the size is set when compressed
+    GLenum format = 0;          // compressed internal format, 0 for uncompressed
+    std::vector<std::vector<unsigned char>> levels;
+    std::string virtualPath;    // tile file when the texture is virtual
+    int virtualTexture = -1;
+    bool solid = false;
+    int array = -1;
+    int layer = -1;
+};
+
+// Texture too large for video memory, drawn through the virtual tile cache. Its mip chain
+// is stored in a tile file in the cache directory as deflated pages of 128x128 texels
+// plus a 4-texel border; `tiles` holds the cache slot of every page (-1 when absent).
+struct VirtualTexture {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    std::vector<int> pagesX, pagesY;
+    std::vector<int> firstTile;         // index of the first page of each level
+    std::vector<uint64_t> tileOffsets;  // file offsets of the pages, plus the end
+    std::vector<int> tiles;
+    std::vector<bool> pending;          // requested from the loader
+    GLuint pageTable = 0;
+    bool dirty = false;
+};
+
+// Page of a virtual texture decoded by a loader thread
+struct VirtualTile {
+    int texture = 0;
+    int tile = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Physical tile cache shared by all virtual textures: one texture of virtualCacheTiles^2
+// bordered pages, the page held by each slot and the frame it was last needed, the loader
+// threads with their queues, and the feedback pass read back a frame late through a PBO
+struct VirtualTileCache {
+    GLuint texture = 0;
+    std::vector<int> slotTexture, slotTile;
+    std::vector<uint64_t> slotUsed;     // UINT64_MAX pins the coarsest page of each texture
+
+    std::vector<std::thread> loaders;
+    std::deque<std::pair<int, int>> requests;
+    std::deque<VirtualTile> results;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+
+    GLuint program = 0;
+    GLuint feedbackFBO = 0;
+    GLuint feedbackTarget = 0;
+    GLuint feedbackDepth = 0;
+    GLuint feedbackPBO = 0;
+    int feedbackWidth = 0;
+    int feedbackHeight = 0;
+    bool feedbackPending = false;
+};
+
+// Integer target of pickRegion^2 pixels the pick pass renders the triangle ids around the
+// cursor into, and the pixel buffer the ids are read back through; the result is mapped a
+// frame or more later, once its fence has signaled, so picking never waits for the GPU
+struct PickingTarget {
+    GLuint fbo = 0;
+    GLuint ids = 0;
+    GLuint depth = 0;
+    GLuint pbo = 0;
+    GLuint program = 0;
+    int validLeft = 0;      // the part of the region inside the window
+    int validBottom = 0;
+    int validRight = 0;
+    int validTop = 0;
+    std::vector<std::pair<size_t, size_t>> frustumRanges;
+    std::vector<std::pair<size_t, size_t>> passRanges;
+    GLsync fence = 0;
+};
+
+// Offscreen targets of weighted blended transparency: premultiplied color with the revealed
+// background in alpha, and the sum of the fragment weights
+struct TransparencyTargets {
+    GLuint fbo = 0;
+    GLuint accumulation = 0;
+    GLuint weights = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+    bool copyDepth = true;      // cleared if the window's depth buffer can't be blitted
+    GLuint resolveProgram = 0;
+    GLuint resolveVAO = 0;
+};
+
+// Offscreen target the overdraw and fragment cost views count fragments in. The programs are
+// compiled on first use.
+struct DebugViewTarget {
+    GLuint fbo = 0;
+    GLuint counts = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+    GLuint program = 0;
+    GLuint resolveProgram = 0;
+    GLuint resolveVAO = 0;
+};
+
+// Depth of the model as seen from the directional light. It is rendered in model space, so
+// it stays valid as long as the light direction relative to the model does.
+struct ShadowMap {
+    GLuint fbo = 0;
+    GLuint depth = 0;
+    glm::vec3 direction = glm::vec3(0.0f);  // model-space light direction it was rendered for
+    glm::mat4 view = glm::mat4(1.0f);       // model space to light space
+    glm::mat4 projection = glm::mat4(1.0f);
+    size_t uploadedBatches = 0;
+    int sectionVersion = 0;     // section planes it was rendered with
+    bool valid = false;
+};
+
+// Corners [first, first + count) drawn with the material `name` (`usemtl`)
+struct MaterialRange {
+    std::string name;
+    size_t first = 0;
+    size_t count = 0;
+};
+
+// GPU buffers holding a contiguous run of LOD clusters
+struct LODBuffer {
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    GLuint NBO = 0;
+    size_t firstCorner = 0;
+};
+
+// Shader objects of a program whose compile and link may still be running in the driver
+struct PendingProgram {
+    GLuint program = 0;
+    GLuint vertexShader = 0;
+    GLuint fragmentShader = 0;
+    std::string cachePath;
+};
+
+// Variant of the scene programs built with a set of #defines. Variants compile in the
+// background and are only used once `ready`; compiles on the worker context signal `fence`.
+struct ShaderVariant {
+    std::string defines;
+    GLuint program = 0;
+    GLuint patchProgram = 0;
+    PendingProgram pending;     // compile in flight through parallel shader compile
+    GLsync fence = 0;
+    bool compiling = false;
+    bool ready = false;
+    bool failed = false;
+};
+
+// Background compilation: a thread with a hidden context sharing objects with the window's,
+// used when the driver can't compile in parallel by itself
+struct ShaderCompiler {
+    const char* vertexSource = NULL;
+    bool tessellation = false;  // variants include a patch program
+    bool driverParallel = false;
+    GLFWwindow* context = NULL;
+    std::thread worker;
+    std::deque<std::string> jobs;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+};
+
+// Compute shaders for GPU normal generation. Corners sharing a position share a weld id;
+// face normals are accumulated per weld id in 16.16 fixed point with atomic adds, then
+// normalized and written into each batch's normal buffer.
+const char* normalAccumulateShaderSource = R"(
+    #version 430 core
+    layout (local_size_x = 256) in;
+
+    layout (std430, binding = 0) readonly buffer Positions { float positions[]; };
+    layout (std430, binding = 1) readonly buffer WeldIds { uint weldIds[]; };
+    layout (std430, binding = 2) buffer Accumulators { int accumulators[]; };
+
+    uniform uint firstTriangle;
+    uniform uint triangleCount;
+
+    void main() {
+        uint triangle = firstTriangle + gl_GlobalInvocationID.x;
+        if (triangle >= triangleCount) return;
+
+        vec3 p[3];
+        for (uint i = 0u; i < 3u; i++) {
+            uint c = 3u * triangle + i;
+            p[i] = vec3(positions[3u * c], positions[3u * c + 1u], positions[3u * c + 2u]);
+        }
+
+        vec3 faceNormal = cross(p[1] - p[0], p[2] - p[0]);
+        float len = length(faceNormal);
+        if (len == 0.0) return;
+        ivec3 q = ivec3(round(faceNormal / len * 65536.0));
+
+        for (uint i = 0u; i < 3u; i++) {
+            uint id = weldIds[3u * triangle + i];
+            atomicAdd(accumulators[3u * id], q.x);
+            atomicAdd(accumulators[3u * id + 1u], q.y);
+            atomicAdd(accumulators[3u * id + 2u], q.z);
+        }
+    }
+)";
+
+const char* normalResolveShaderSource = R"(
+    #version 430 core
+    layout (local_size_x = 256) in;
+
+    layout (std430, binding = 1) readonly buffer WeldIds { uint weldIds[]; };
+    layout (std430, binding = 2) readonly buffer Accumulators { int accumulators[]; };
+    layout (std430, binding = 3) writeonly buffer Normals { float normals[]; };
+
+    uniform uint firstCorner;
+    uniform uint cornerCount;
+
+    void main() {
+        uint c = firstCorner + gl_GlobalInvocationID.x;
+        if (c >= cornerCount) return;
+
+        uint id = weldIds[c];
+        vec3 n = vec3(accumulators[3u * id], accumulators[3u * id + 1u], accumulators[3u * id + 2u]);
+        n = dot(n, n) > 0.0 ? normalize(n) : vec3(0.0, 0.0, 1.0);
+
+        normals[3u * c] = n.x;
+        normals[3u * c + 1u] = n.y;
+        normals[3u * c + 2u] = n.z;
+    }
+)";
+
+// Tessellation program for quad patches (GL 4.0). Each quad becomes a bicubic PN patch:
+// edge control points are the 1/3 points of each edge projected onto the corner tangent
+// planes, so shared edges evaluate identically on both sides. Tessellation levels follow
+// the projected edge lengths.
+const char* patchVertexShaderSource = R"(
+    #version 400 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in vec3 aNormal;
+
+    out vec3 vPos;
+    out vec3 vNormal;
+
+    void main() {
+        vPos = aPos;
+        vNormal = aNormal;
+    }
+)";
+
+const char* patchControlShaderSource = R"(
+    #version 400 core
+    layout (vertices = 4) out;
+
+    in vec3 vPos[];
+    in vec3 vNormal[];
+    out vec3 tcPos[];
+    out vec3 tcNormal[];
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec2 viewportSize;
+    uniform float pixelsPerSegment;
+
+    vec2 toScreen(vec3 p) {
+        vec4 clip = projection * view * model * vec4(p, 1.0);
+        return clip.xy / max(clip.w, 0.0001) * 0.5 * viewportSize;
+    }
+
+    float edgeLevel(vec2 a, vec2 b) {
+        return clamp(distance(a, b) / pixelsPerSegment, 1.0, 64.0);
+    }
+
+    void main() {
+        tcPos[gl_InvocationID] = vPos[gl_InvocationID];
+        tcNormal[gl_InvocationID] = vNormal[gl_InvocationID];
+
+        if (gl_InvocationID == 0) {
+            vec2 s0 = toScreen(vPos[0]);
+            vec2 s1 = toScreen(vPos[1]);
+            vec2 s2 = toScreen(vPos[2]);
+            vec2 s3 = toScreen(vPos[3]);
+
+            gl_TessLevelOuter[0] = edgeLevel(s0, s3);
+            gl_TessLevelOuter[1] = edgeLevel(s0, s1);
+            gl_TessLevelOuter[2] = edgeLevel(s1, s2);
+            gl_TessLevelOuter[3] = edgeLevel(s3, s2);
+            gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+            gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+        }
+    }
+)";
+
+const char* patchEvaluationShaderSource = R"(
+    #version 400 core
+    layout (quads, fractional_even_spacing, ccw) in;
+
+    in vec3 tcPos[];
+    in vec3 tcNormal[];
+    out vec3 FragPos;
+    out vec3 Normal;
+    out vec4 TexCoord;
+    out float gl_ClipDistance[6];
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec4 sectionPlanes[6];
+
+    // Control point 1/3 of the way from corner a to corner b, on a's tangent plane
+    vec3 edgePoint(int a, int b) {
+        vec3 n = tcNormal[a];
+        n = dot(n, n) > 0.0 ? normalize(n) : n;
+        vec3 pa = tcPos[a];
+        vec3 pb = tcPos[b];
+        return (2.0 * pa + pb) / 3.0 - dot(pb - pa, n) / 3.0 * n;
+    }
+
+    vec4 bernstein(float t) {
+        float s = 1.0 - t;
+        return vec4(s * s * s, 3.0 * t * s * s, 3.0 * t * t * s, t * t * t);
+    }
+
+    void main() {
+        // Corners at (u, v) = (0,0), (1,0), (1,1), (0,1); b[i + 4 * j] is row j along u
+        vec3 b[16];
+        b[0] = tcPos[0];
+        b[3] = tcPos[1];
+        b[15] = tcPos[2];
+        b[12] = tcPos[3];
+        b[1] = edgePoint(0, 1);
+        b[2] = edgePoint(1, 0);
+        b[7] = edgePoint(1, 2);
+        b[11] = edgePoint(2, 1);
+        b[14] = edgePoint(2, 3);
+        b[13] = edgePoint(3, 2);
+        b[8] = edgePoint(3, 0);
+        b[4] = edgePoint(0, 3);
+        b[5] = b[1] + b[4] - b[0];
+        b[6] = b[2] + b[7] - b[3];
+        b[10] = b[14] + b[11] - b[15];
+        b[9] = b[13] + b[8] - b[12];
+
+        float u = gl_TessCoord.x;
+        float v = gl_TessCoord.y;
+        vec4 bu = bernstein(u);
+        vec4 bv = bernstein(v);
+        vec3 position = vec3(0.0);
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                position += b[i + 4 * j] * bu[i] * bv[j];
+            }
+        }
+        vec3 normal = mix(mix(tcNormal[0], tcNormal[1], u), mix(tcNormal[3], tcNormal[2], u), v);
+
+        FragPos = vec3(model * vec4(position, 1.0));
+        Normal = mat3(transpose(inverse(model))) * normal;
+        TexCoord = vec4(0.0, 0.0, 0.0, 1.0);
+        gl_Position = projection * view * model * vec4(position, 1.0);
+        for (int i = 0; i < 6; i++) {
+            gl_ClipDistance[i] = dot(sectionPlanes[i], vec4(position, 1.0));
+        }
+    }
+)";
+
+// Virtual texture feedback: the page and mip level each pixel of a low-resolution pass
+// would sample, with `lodBias` compensating for the lower resolution
+const char* virtualFeedbackFragmentShaderSource = R"(
+    #version 330 core
+    in vec4 TexCoord;
+    out uvec4 feedback;
+    
+    uniform int virtualId;
+    uniform ivec2 virtualSize;
+    uniform int virtualLevels;
+    uniform float lodBias;
+    
+    void main() {
+        vec2 texel = TexCoord.xy * vec2(virtualSize);
+        float lod = log2(max(length(dFdx(texel)), length(dFdy(texel)))) + lodBias;
+        int level = int(clamp(lod, 0.0, float(virtualLevels - 1)));
+        ivec2 page = ivec2(fract(TexCoord.xy) * vec2(max(virtualSize >> level, 1)) / 128.0);
+        feedback = uvec4(virtualId + 1, level, page);
+    }
+)";
+
+// Octahedral impostors: every object is baked from impostorGrid x impostorGrid directions
+// spread over the sphere by octahedral mapping, storing model-space normals and coverage
+// rather than lit colour so impostors are relit as the model turns. At draw time each
+// billboard shows the view nearest to the current direction.
+const char* impostorBakeFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec3 FragPos;
+    in vec3 Normal;
+
+    uniform bool flatShading;
+
+    void main() {
+        vec3 norm = flatShading ? normalize(cross(dFdx(FragPos), dFdy(FragPos))) : normalize(Normal);
+        FragColor = vec4(norm * 0.5 + 0.5, 1.0);
+    }
+)";
+
+const char* impostorVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec4 aSphere;  // object center and radius in model space
+    layout (location = 1) in float aLayer;
+
+    out vec3 FragPos;
+    out vec3 TexCoord;
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+    uniform vec3 viewPos;
+    uniform int gridSize;
+
+    void main() {
+        // Pick the baked view closest to the direction towards the camera, in model space
+        vec3 center = vec3(model * vec4(aSphere.xyz, 1.0));
+        vec3 toCamera = normalize(inverse(mat3(model)) * (viewPos - center));
+        vec2 cell = clamp(floor((encodeOctahedral(toCamera) * 0.5 + 0.5) * float(gridSize)), 0.0, float(gridSize - 1));
+        vec3 direction = decodeOctahedral((cell + 0.5) / float(gridSize) * 2.0 - 1.0);
+
+        // Same camera basis as the bake
+        vec3 reference = abs(direction.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+        vec3 right = normalize(cross(reference, direction));
+        vec3 up = cross(direction, right);
+
+        vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+        vec3 position = aSphere.xyz + (right * corner.x + up * corner.y) * aSphere.w;
+        FragPos = vec3(model * vec4(position, 1.0));
+        TexCoord = vec3((cell + corner * 0.5 + 0.5) / float(gridSize), aLayer);
+        gl_Position = projection * view * vec4(FragPos, 1.0);
+    }
+)";
+
+const char* impostorFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    in vec3 FragPos;
+    in vec3 TexCoord;
+
+    uniform sampler2DArray impostors;
+    uniform mat4 model;
+    uniform vec3 viewPos;
+    uniform vec3 lightDir;
+    uniform vec3 materialColor;
+
+    void main() {
+        vec4 texel = texture(impostors, TexCoord);
+        if (texel.a < 0.5) discard;
+        vec3 norm = normalize(mat3(model) * (texel.xyz * 2.0 - 1.0));
+
+        // Same lighting as the mesh
+        vec3 ambient = 0.3 * materialColor;
+        vec3 lightDirection = normalize(lightDir);
+        vec3 diffuse = max(dot(norm, lightDirection), 0.0) * materialColor;
+        vec3 viewDir = normalize(viewPos - FragPos);
+        vec3 halfwayDir = normalize(lightDirection + viewDir);
+        vec3 specular = 0.5 * pow(max(dot(norm, halfwayDir), 0.0), 64.0) * vec3(1.0);
+
+        FragColor = vec4(pow(ambient + diffuse + specular, vec3(1.0/2.2)), 1.0);
+    }
+)";
+
+// Camera variables
+glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
+glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+
+// Mouse control variables
+float lastX = 400.0f;
+float lastY = 300.0f;
+bool firstMouse = true;
+bool mousePressed = false;
+float zoom = 45.0f;
+
+// Object rotation variables
+float rotationX = 0.0f;
+float rotationY = 0.0f;
+
+// Rendering settings
+bool showWireframe = false;
+bool flatShading = false;
+int shadingMode = 0;        // index into shadingModes, cycled with M
+bool normalStream = true;   // false with --flat: no normals are generated or uploaded
+bool gpuNormals = false;    // generate missing normals with compute shaders (GL 4.3)
+bool vertexPulling = false; // fetch compressed vertices from buffer textures instead of attributes
+
+// Loader settings
+bool writeOBJIndexFile = true;
+const int objIndexVersion = 2;
+const size_t objIndexRunRecords = 4096;   // v/vt/vn records per index run at most
+bool keepQuadPatches = false;   // keep quads whole for hardware tessellation
+
+// Quads kept as patches (4 corners each), drawn with tessellation instead of as triangles
+std::vector<glm::vec3> patchVertices;
+std::vector<glm::vec3> patchNormals;
+
+// Objects of the loaded mesh, and the on-screen diameter in pixels below which an object
+// is drawn as an impostor (0 disables impostors)
+std::vector<SceneObject> sceneObjects;
+float impostorPixels = 32.0f;
+const int impostorGrid = 8;         // baked views per side of the octahedral atlas
+const int impostorTileSize = 32;    // pixels per baked view
+const size_t impostorMinCorners = 768;  // smaller objects are cheaper drawn as geometry
+
+// Materials of the loaded mesh. Textures are packed into 2D texture arrays (one per
+// texture size) so all materials draw with one bind per array.
+bool loadTextures = true;
+bool compressTextures = true;   // transcode to BC1/BC3 and cache the result on disk
+
+// Virtual texturing: textures larger than `virtualTexturePixels` on either side (0 disables)
+// are paged through a fixed cache of virtualCacheTiles^2 tiles. Feedback is rendered at
+// 1/virtualFeedbackScale of the window size every virtualFeedbackInterval frames.
+int virtualTexturePixels = 8192;
+const int virtualPageSize = 128;
+const int virtualPageBorder = 4;
+const int virtualCacheTiles = 30;
+const int virtualFeedbackScale = 8;
+const int virtualFeedbackInterval = 4;
+const int virtualUploadsPerFrame = 16;
+std::vector<VirtualTexture> virtualTextures;
+VirtualTileCache virtualCache;
+std::mutex virtualBuildMutex;   // tile files are built one at a time to bound memory
+std::vector<std::string> materialLibraries;
+std::vector<Material> materials;
+std::vector<MaterialTexture> materialTextures;
+std::vector<MaterialRange> materialRanges;
+
+// Materials with dissolve (`d`/`Tr`) below 1 are drawn after everything else with weighted
+// blended order-independent transparency, so no per-frame sorting is needed
+TransparencyTargets transparency;
+
+// GPU memory per mesh batch (positions and normals)
+size_t batchBytes = (size_t)256 << 20;
+
+// Continuous LOD: clusters of this many triangles, drawn where their simplification error
+// is below `lodErrorPixels` on screen; with a triangle budget the threshold adapts per frame
+bool lodEnabled = false;
+const size_t lodClusterSize = 128;
+float lodErrorPixels = 1.0f;
+size_t lodTriangleBudget = 0;
+
+// Shader settings
+bool useShaderCache = true;
+
+// Zip bundle the model was loaded from, and the MTL/texture files read for it
+ZipArchive bundleArchive;
+std::map<std::string, AssetData> assetCache;
+std::mutex assetCacheMutex;
+std::string assetBaseDir;
+
+// Light and material settings
+glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+glm::vec3 materialColor = glm::vec3(0.9f, 0.9f, 0.95f);
+
+// Shading modes, each a permutation of the scene fragment shader selected by its define.
+// The cheap modes skip per-fragment specular and shadows: the matcap bakes the default
+// lighting (as seen from the camera) into one lookup, spherical harmonics light the model
+// with a sky environment projected once at startup.
+struct ShadingMode {
+    const char* name;
+    const char* define;
+};
+const ShadingMode shadingModes[] = {
+    {"phong", ""},
+    {"matcap", "#define MATCAP\n"},
+    {"sh", "#define SPHERICAL_HARMONICS\n"},
+};
+const int shadingModeCount = sizeof(shadingModes) / sizeof(shadingModes[0]);
+const int matcapSize = 256;
+glm::vec3 shCoefficients[9];
+
+// Scene program variants by their defines; the fields of a variant that is compiling belong
+// to the compiler until it is ready
+std::map<std::string, ShaderVariant> shaderVariants;
+ShaderCompiler shaderCompiler;
+
+// Feature lines (--edges): boundary, crease (dihedral angle above `featureAngle` degrees) and
+// non-manifold edges found at load time, drawn from per-batch line index buffers, plus
+// silhouettes selected from the other edges every frame, edgeClusterSize edges at a time
+bool edgesEnabled = false;
+bool showEdges = true;
+float featureAngle = 30.0f;
+const size_t edgeClusterSize = 256;
+glm::vec3 edgeColor = glm::vec3(0.05f, 0.05f, 0.08f);
+std::vector<size_t> featureEdges;   // global corner pairs, sorted
+std::vector<SilhouetteVertex> silhouetteVertices;
+std::vector<EdgeCluster> edgeClusters;
+glm::vec3 silhouetteOrigin = glm::vec3(0.0f);
+glm::vec3 silhouetteExtent = glm::vec3(0.0f);
+
+// Section planes, positioned from the keyboard. Each keeps the half-space where
+// dot(plane, vec4(p, 1)) >= 0 for p in the model's normalized frame (centered, radius 1),
+// so a plane stays put on the part while it turns. sectionModelPlanes holds the same
+// planes in model space for the shaders and culling, refreshed every frame.
+const int maxSectionPlanes = 6;
+glm::vec4 sectionPlanes[maxSectionPlanes];
+glm::vec4 sectionModelPlanes[maxSectionPlanes];
+int sectionPlaneCount = 0;
+int selectedSectionPlane = 0;
+int sectionVersion = 0;     // bumped on every change of the planes
+bool capSections = true;
+glm::vec3 sectionCapColor = glm::vec3(0.8f, 0.35f, 0.25f);
+const size_t sectionClusterCorners = 3 * 256;
+std::vector<SectionCluster> sectionClusters;
+
+// Slicing (--slice-step): after loading, the triangles are cut by the planes perpendicular to
+// axis `sliceAxis` every `sliceStep` model units, in parallel across planes. The polylines
+// are written to `sliceOutputPath` (SVG, or CSV for any other extension) and drawn as lines.
+int sliceAxis = 2;
+float sliceStep = 0.0f;
+std::string sliceOutputPath;
+bool showSlices = true;
+glm::vec3 sliceColor = glm::vec3(0.1f, 0.55f, 0.95f);
+const size_t maxSlicePlanes = 100000;
+std::vector<MeshSlice> meshSlices;
+
+// Thumbnail runs (--thumbnails DIR): every model on the command line is rendered into a
+// thumbnailSize^2 tile of a shared offscreen page of up to thumbnailPageSize^2 pixels,
+// and each page is read back once and cut into PNG files in `thumbnailDirectory`
+std::string thumbnailDirectory;
+int thumbnailSize = 256;
+const int thumbnailPageSize = 4096;
+std::mutex thumbnailLoadMutex;
+
+// Picking (--picking): the triangle under the cursor is found with an ID pass over a
+// pickRegion^2 pixel square around it, and its object (`o`) is highlighted
+bool pickingEnabled = false;
+const int pickRegion = 5;
+PickingTarget picking;
+glm::vec3 highlightColor = glm::vec3(1.0f, 0.75f, 0.2f);
+
+// Debug views for finding out why a model renders slowly, cycled with D. Each replaces the
+// shaded image of the mesh: overdraw counts every fragment rasterized, fragment cost only
+// those that pass the depth test in draw order (the ones that get shaded), triangle density
+// shows how many triangles share a pixel and index order each triangle's position in the
+// file, which shows how local the face order is.
+struct DebugViewMode {
+    const char* name;
+    const char* legend;
+    bool countFragments;    // accumulated in debugView's target and resolved
+    bool depthTest;
+};
+const DebugViewMode debugViewModes[] = {
+    {"off", "", false, true},
+    {"overdraw", "fragments per pixel, dark blue 1 to red 16 or more", true, false},
+    {"triangle density", "triangles per pixel, dark blue 1/1024 to red 1 or more", false, true},
+    {"index order", "triangle order in the file, dark blue first to red last", false, true},
+    {"fragment cost", "fragments shaded per pixel, dark blue 1 to red 16 or more", true, true},
+};
+const int debugViewModeCount = sizeof(debugViewModes) / sizeof(debugViewModes[0]);
+const float debugViewMaxCount = 16.0f;
+int debugViewMode = 0;
+DebugViewTarget debugView;
+
+// Shadows from `lightDir`. The shadow map is re-rendered only when the light direction
+// relative to the model changes or more of the mesh is uploaded; with `lockLightToModel`
+// the light turns with the model, so rotating doesn't invalidate it either.
+bool shadowsEnabled = true;
+bool lockLightToModel = false;
+const int shadowMapSize = 2048;
+ShadowMap shadow;
+
+// Function prototypes
+GLuint compileShaders(const char* vertexSource, const char* fragmentSource);
+void beginCompileShaders(PendingProgram& pending, const char* vertexSource, const char* fragmentSource);
+GLuint finishCompileShaders(PendingProgram& pending);
+bool loadOBJ(const char* path, 
+             std::vector<glm::vec3>& out_vertices, 
+             std::vector<glm::vec3>& out_normals, 
+             std::vector<glm::vec2>& out_uvs);
+bool loadOBJObject(const char* path, const std::string& name,
+                   std::vector<glm::vec3>& out_vertices, 
+                   std::vector<glm::vec3>& out_normals, 
+                   std::vector<glm::vec2>& out_uvs);
+bool loadOBJBundle(const char* path, 
+                   std::vector<glm::vec3>& out_vertices, 
+                   std::vector<glm::vec3>& out_normals, 
+                   std::vector<glm::vec2>& out_uvs);
+void closeZipArchive(ZipArchive& archive);
+std::string toLower(std::string text);
+bool endsWith(const std::string& text, const std::string& suffix);
+std::string parentPath(const std::string& path);
+void calculateSmoothNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals);
+std::vector<MeshBatch> planMeshBatches(size_t vertexCount, size_t maxBytes, size_t maxCorners);
+void uploadMeshBatch(MeshBatch& batch, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+                     const std::vector<glm::vec4>& texCoords, const std::vector<uint32_t>& weldIds);
+void uploadPulledBatch(MeshBatch& batch, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals);
+glm::vec2 encodeOctahedral(glm::vec3 n);
+glm::vec3 decodeOctahedral(glm::vec2 e);
+void weldPositions(const std::vector<glm::vec3>& vertices, std::vector<uint32_t>& weldIds);
+bool computeShadersSupported();
+GLuint compileComputeShader(const char* source);
+void computeNormalsGPU(std::vector<MeshBatch>& batches, uint32_t weldCount,
+                       GLuint accumulateProgram, GLuint resolveProgram);
+GLFWwindow* createWindow(int major, int minor, GLFWwindow* share = NULL);
+void setSceneUniforms(GLuint program, const glm::mat4& model, const glm::mat4& view,
+                      const glm::mat4& projection, bool flat);
+GLuint compileTessellationShaders(const char* fragmentSource);
+GLuint compileSilhouetteShaders();
+void extractEdges(const std::vector<glm::vec3>& vertices);
+void uploadFeatureEdges(MeshBatch& batch);
+void drawFeatureEdges(GLuint program, const std::vector<MeshBatch>& batches);
+void selectSilhouetteClusters(const glm::vec3& modelCamera, std::vector<GLint>& firsts, std::vector<GLsizei>& counts);
+void buildSectionClusters(const std::vector<glm::vec3>& vertices);
+void updateSectionPlanes(const glm::vec3& center, float radius);
+void enableSectionPlanes(unsigned int mask);
+bool sectionClipsSphere(const glm::vec3& center, float radius, unsigned int mask);
+void selectSectionRanges(unsigned int mask, std::vector<std::pair<size_t, size_t>>& ranges);
+void selectFrustumRanges(const glm::mat4& modelViewProjection, const std::vector<SceneObject>& objects,
+                         std::vector<std::pair<size_t, size_t>>& ranges);
+void drawSectionCap(GLuint vbo, int plane, const glm::vec3& center, float radius);
+bool sliceMesh(const std::vector<glm::vec3>& vertices, int axis, float step, std::vector<MeshSlice>& slices);
+bool writeSlicesSVG(const std::string& path, const std::vector<MeshSlice>& slices, int axis);
+bool writeSlicesCSV(const std::string& path, const std::vector<MeshSlice>& slices, int axis);
+bool loadThumbnailMesh(Thumbnail& thumbnail);
+bool renderPickIds(const std::vector<MeshBatch>& batches, const std::vector<std::pair<size_t, size_t>>& ranges,
+                   const std::vector<SceneObject>& objects, const glm::mat4& model, const glm::mat4& view,
+                   const glm::mat4& projection, int width, int height, int x, int y);
+bool readPickResult(uint32_t& id);
+void destroyPicking();
+GLuint beginDebugView(const char* vertexSource, int width, int height, const glm::mat4& model,
+                      const glm::mat4& view, const glm::mat4& projection, size_t triangleCount);
+void endDebugView(int width, int height);
+void destroyDebugView();
+bool writePNG(const std::string& path, int width, int height, const unsigned char* rgba, ptrdiff_t stride);
+bool renderThumbnails(const std::vector<const char*>& paths);
+std::string shaderPermutation(const char* source, const char* defines);
+void startShaderCompiler(GLFWwindow* window, const char* vertexSource, bool tessellation);
+void stopShaderCompiler();
+ShaderVariant& requestShaderVariant(const std::string& defines);
+bool shaderVariantReady(ShaderVariant& variant);
+void setSceneSamplerUnits(GLuint program);
+GLuint createMatcapTexture();
+void computeEnvironmentSH();
+void calculatePatchNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+                           const std::vector<glm::vec3>& patches, std::vector<glm::vec3>& patchNormals);
+void appendPatchesAsTriangles(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+                              std::vector<glm::vec3>& patches, std::vector<glm::vec3>& patchNormals);
+void releaseMeshCopies(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec2>& uvs);
+void loadMaterials();
+std::vector<GLuint> createMaterialArrays();
+void buildMaterialCorners(const std::vector<glm::vec2>& uvs, size_t cornerCount, size_t arrayCount,
+                          std::vector<glm::vec4>& texCoords,
+                          std::vector<std::vector<std::pair<size_t, size_t>>>& arrayRanges,
+                          std::vector<std::pair<size_t, size_t>>& transparentRanges);
+void intersectRanges(const std::vector<std::pair<size_t, size_t>>& a, const std::vector<std::pair<size_t, size_t>>& b,
+                     std::vector<std::pair<size_t, size_t>>& out);
+bool startVirtualTextures();
+void stopVirtualTextures();
+void bindVirtualTexture(GLuint program, int index);
+void renderVirtualFeedback(const std::vector<MeshBatch>& batches,
+                           const std::vector<std::vector<std::pair<size_t, size_t>>>& ranges,
+                           const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                           int width, int height);
+void updateVirtualTextures(uint64_t frame);
+bool createShadowMap();
+void beginShadowMap(const glm::vec3& direction, const glm::vec3& center, float radius);
+void endShadowMap(int width, int height);
+void setShadowUniforms(GLuint program, const glm::mat4& model);
+bool beginTransparency(int width, int height);
+void resolveTransparency(int width, int height);
+void destroyTransparency();
+void buildLOD(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, LODMesh& lod);
+std::string lodCachePath(const char* path, const std::string& objectName);
+bool readLODCache(const std::string& path, LODMesh& lod);
+void writeLODCache(const std::string& path, const LODMesh& lod);
+void uploadLOD(LODMesh& lod, std::vector<LODBuffer>& buffers);
+void calculateObjectBounds(const std::vector<glm::vec3>& vertices);
+void drawMeshRanges(GLuint program, const std::vector<MeshBatch>& batches,
+                    const std::vector<std::pair<size_t, size_t>>& ranges);
+void bindMeshBatch(GLuint program, const MeshBatch& batch);
+GLuint createImpostorAtlas();
+void bakeImpostor(GLuint program, const std::vector<MeshBatch>& batches, SceneObject& object, GLuint atlas);
+size_t selectLODClusters(const LODMesh& lod, const std::vector<LODBuffer>& buffers, const glm::mat4& model,
+                         const glm::mat4& viewProjection, float pixelsPerRadian, float threshold, unsigned int sectionMask,
+                         std::vector<std::vector<GLint>>& firsts, std::vector<std::vector<GLsizei>>& counts);
+
+// Callback functions
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+int main(int argc, char* argv[]) {
+    // Parse command line options
+    const char* objFilePath = NULL;
+    std::vector<const char*> modelPaths;
+    std::string objectName;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--object" && i + 1 < argc) {
+            objectName = argv[++i];
+        } else if (arg == "--no-index") {
+            writeOBJIndexFile = false;
+        } else if (arg == "--no-shader-cache") {
+            useShaderCache = false;
+        } else if (arg == "--no-textures") {
+            loadTextures = false;
+        } else if (arg == "--no-texture-compression") {
+            compressTextures = false;
+        } else if (arg == "--virtual-texture-px" && i + 1 < argc) {
+            virtualTexturePixels = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--flat") {
+            flatShading = true;
+            normalStream = false;
+        } else if (arg == "--gpu-normals") {
+            gpuNormals = true;
+        } else if (arg == "--vertex-pulling") {
+            vertexPulling = true;
+        } else if (arg == "--tessellate") {
+            keepQuadPatches = true;
+        } else if (arg == "--lod") {
+            lodEnabled = true;
+        } else if (arg == "--triangle-budget" && i + 1 < argc) {
+            lodEnabled = true;
+            lodTriangleBudget = (size_t)std::max(0.0, atof(argv[++i]));
+        } else if (arg == "--impostor-px" && i + 1 < argc) {
+            impostorPixels = (float)std::max(0.0, atof(argv[++i]));
+        } else if (arg == "--shading" && i + 1 < argc) {
+            std::string name = argv[++i];
+            for (int m = 0; m < shadingModeCount; m++) {
+                if (name == shadingModes[m].name) shadingMode = m;
+            }
+        } else if (arg == "--edges") {
+            edgesEnabled = true;
+        } else if (arg == "--feature-angle" && i + 1 < argc) {
+            edgesEnabled = true;
+            featureAngle = (float)atof(argv[++i]);
+        } else if (arg == "--slice-step" && i + 1 < argc) {
+            sliceStep = (float)std::max(0.0, atof(argv[++i]));
+        } else if (arg == "--slice-axis" && i + 1 < argc) {
+            std::string axis = toLower(argv[++i]);
+            sliceAxis = axis == "x" ? 0 : axis == "y" ? 1 : 2;
+        } else if (arg == "--slice-out" && i + 1 < argc) {
+            sliceOutputPath = argv[++i];
+        } else if (arg == "--no-shadows") {
+            shadowsEnabled = false;
+        } else if (arg == "--lock-light") {
+            lockLightToModel = true;
+        } else if (arg == "--batch-mb" && i + 1 < argc) {
+            batchBytes = (size_t)std::max(1, atoi(argv[++i])) << 20;
+        } else if (arg == "--picking") {
+            pickingEnabled = true;
+        } else if (arg == "--thumbnails" && i + 1 < argc) {
+            thumbnailDirectory = argv[++i];
+        } else if (arg == "--thumbnail-px" && i + 1 < argc) {
+            thumbnailSize = std::max(16, std::min(thumbnailPageSize, atoi(argv[++i])));
+        } else if (arg.rfind("--", 0) != 0) {
+            modelPaths.push_back(argv[i]);
+        } else {
+            modelPaths.clear();
+            break;
+        }
+    }
+
+    // A thumbnail run takes any number of models and exits when they are written
+    if (!thumbnailDirectory.empty() && !modelPaths.empty()) {
+        return renderThumbnails(modelPaths) ? 0 : -1;
+    }
+    if (modelPaths.size() == 1) {
+        objFilePath = modelPaths[0];
+    }
+
+    // Check if OBJ file path is provided
+    if (objFilePath == NULL) {
+        std::cerr << "Usage: " << argv[0] << " <path_to_obj_file> [--object NAME] [--no-index] [--no-shader-cache] [--no-textures] [--no-texture-compression] [--virtual-texture-px N] [--batch-mb N] [--flat] [--gpu-normals] [--vertex-pulling] [--tessellate] [--lod] [--triangle-budget N] [--impostor-px N] [--no-shadows] [--lock-light] [--shading MODE] [--edges] [--feature-angle DEG] [--slice-step D] [--slice-axis x|y|z] [--slice-out FILE] [--picking]\n"
+                  << "       " << argv[0] << " --thumbnails DIR [--thumbnail-px N] <path_to_obj_file>..." << std::endl;
+        return -1;
+    }
+
+    // Bundles have no sidecar index to find the blocks in
+    if (!objectName.empty() && endsWith(toLower(objFilePath), ".zip")) {
+        std::cerr << "--object is not supported for zip bundles, loading the whole model" << std::endl;
+        objectName.clear();
+    }
+
+    // Load OBJ file and generate normals on a worker thread while the main thread
+    // creates the window and context and compiles the shaders
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> weldIds;
+
+    // Pulled vertices are encoded on the CPU, and patch normals are computed together with
+    // the triangles' on the CPU, so those normals must exist there too
+    if (vertexPulling || keepQuadPatches) {
+        gpuNormals = false;
+    }
+
+    // The LOD hierarchy is built from the whole mesh on the CPU and drawn from its own
+    // buffers with the plain vertex layout
+    if (lodEnabled) {
+        gpuNormals = false;
+        vertexPulling = false;
+        keepQuadPatches = false;
+    }
+    LODMesh lod;
+
+    // Texture coordinates are only part of the plain vertex layout
+    if (lodEnabled || vertexPulling) {
+        loadTextures = false;
+    }
+
+    // Edges and picked triangles index the corners of the full-detail batches, which LOD
+    // doesn't draw
+    if (lodEnabled) {
+        edgesEnabled = false;
+        pickingEnabled = false;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto loadMesh = [&]() {
+        std::cout << "Loading OBJ file: " << objFilePath << std::endl;
+        bool loaded;
+        if (endsWith(toLower(objFilePath), ".zip")) {
+            loaded = loadOBJBundle(objFilePath, vertices, normals, uvs);
+        } else {
+            assetBaseDir = parentPath(objFilePath);
+            loaded = objectName.empty()
+                ? loadOBJ(objFilePath, vertices, normals, uvs)
+                : loadOBJObject(objFilePath, objectName, vertices, normals, uvs);
+        }
+        if (!loaded || (vertices.empty() && patchVertices.empty())) {
+            std::cerr << "Failed to load OBJ file: " << objFilePath << std::endl;
+            return false;
+        }
+        std::cout << "OBJ file loaded successfully. Vertices: " << vertices.size() << std::endl;
+        if (!patchVertices.empty()) {
+            std::cout << "Quad patches: " << patchVertices.size() / 4 << std::endl;
+        }
+        if (loadTextures && !materialLibraries.empty()) {
+            loadMaterials();
+            std::cout << "Materials: " << materials.size() << ", textures: " << materialTextures.size() << std::endl;
+        }
+
+        // Flat shading derives normals in the fragment shader
+        if (!normalStream) {
+            std::vector<glm::vec3>().swap(normals);
+            std::vector<glm::vec3>().swap(patchNormals);
+            return true;
+        }
+
+        // Triangles and patches share smooth normals where they meet
+        if (!patchVertices.empty()) {
+            if (normals.size() != vertices.size() || patchNormals.size() != patchVertices.size()) {
+                calculatePatchNormals(vertices, normals, patchVertices, patchNormals);
+            }
+            return true;
+        }
+
+        // Calculate smooth normals if none provided
+        if (normals.empty() || normals.size() != vertices.size()) {
+            normals.clear();
+            if (gpuNormals) {
+                // Only weld identical positions here; the normals are accumulated on the GPU
+                weldPositions(vertices, weldIds);
+                return true;
+            }
+            normals.resize(vertices.size(), glm::vec3(0.0f));
+            calculateSmoothNormals(vertices, normals);
+        }
+        return true;
+    };
+
+    auto sliceLoadedMesh = [&](const std::vector<glm::vec3>& triangles) {
+        if (sliceStep <= 0.0f) return;
+        auto sliceStart = std::chrono::steady_clock::now();
+        if (!sliceMesh(triangles, sliceAxis, sliceStep, meshSlices)) return;
+        size_t polylines = 0;
+        for (const auto& slice : meshSlices) {
+            polylines += slice.polylines.size();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - sliceStart;
+        std::cout << "Sliced into " << meshSlices.size() << " planes, " << polylines << " polylines in "
+                  << elapsed.count() << " ms" << std::endl;
+        if (sliceOutputPath.empty()) return;
+        bool written = endsWith(toLower(sliceOutputPath), ".svg")
+            ? writeSlicesSVG(sliceOutputPath, meshSlices, sliceAxis)
+            : writeSlicesCSV(sliceOutputPath, meshSlices, sliceAxis);
+        if (written) {
+            std::cout << "Slices written to " << sliceOutputPath << std::endl;
+        }
+    };
+
+    std::future<bool> meshLoad = std::async(std::launch::async, [&]() {
+        if (!lodEnabled) {
+            if (!loadMesh()) {
+                return false;
+            }
+            if (edgesEnabled) {
+                extractEdges(vertices);
+            }
+            buildSectionClusters(vertices);
+            sliceLoadedMesh(vertices);
+            return true;
+        }
+
+        // A cached hierarchy replaces parsing the model altogether
+        std::string lodPath = lodCachePath(objFilePath, objectName);
+        if (!lodPath.empty() && readLODCache(lodPath, lod)) {
+            std::cout << "LOD hierarchy loaded from cache: " << lod.clusters.size() << " clusters" << std::endl;
+            // The full-detail level is the start of the soup, so slice that
+            if (sliceStep > 0.0f) {
+                sliceLoadedMesh(std::vector<glm::vec3>(lod.positions.begin(), lod.positions.begin() + lod.baseCorners));
+            }
+            return true;
+        }
+        if (!loadMesh()) {
+            return false;
+        }
+        sliceLoadedMesh(vertices);
+
+        buildLOD(vertices, normals, lod);
+        std::cout << "LOD hierarchy built: " << lod.clusters.size() << " clusters in "
+                  << lod.clusters.back().level + 1 << " levels" << std::endl;
+        if (!lodPath.empty()) {
+            writeLODCache(lodPath, lod);
+        }
+        std::vector<glm::vec3>().swap(vertices);
+        std::vector<glm::vec3>().swap(normals);
+        return true;
+    });
+
+    // Initialize GLFW
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+
+    // Create window, asking for a newer context when an optional feature needs one
+    GLFWwindow* window = NULL;
+    if (gpuNormals) {
+        window = createWindow(4, 3);
+    } else if (keepQuadPatches) {
+        window = createWindow(4, 0);
+    }
+    if (window == NULL) {
+        window = createWindow(3, 3);
+    }
+    if (window == NULL) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    // Initialize GLEW
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        return -1;
+    }
+
+    // Print basic controls to console
+    std::cout << "========== OBJ Viewer Controls ==========\n";
+    std::cout << "Mouse Drag: Rotate model\n";
+    std::cout << "Scroll: Zoom in/out\n";
+    std::cout << "W: Toggle wireframe\n";
+    std::cout << "F: Toggle flat shading\n";
+    std::cout << "M: Cycle shading mode\n";
+    std::cout << "E: Toggle feature edges and silhouettes\n";
+    std::cout << "C: Add a section plane facing the camera\n";
+    std::cout << "Tab / R / X: Select next / face camera / remove section plane\n";
+    std::cout << "[ / ]: Move the section plane (Shift: faster)\n";
+    std::cout << "H: Toggle section caps\n";
+    std::cout << "L: Toggle slice lines\n";
+    std::cout << "D: Cycle debug views\n";
+    std::cout << "Esc: Exit\n";
+    std::cout << "========================================\n";
+
+    // Start compiling shaders; with parallel shader compile the driver does this in the background
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+    if (!GLEW_KHR_parallel_shader_compile && GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+#endif
+    const std::string pullingSource = shaderPermutation(pullingVertexShaderSource, octahedralShaderSource);
+    const char* sceneVertexSource = vertexPulling ? pullingSource.c_str() : vertexShaderSource;
+    std::string sceneFragmentSource = shaderPermutation(fragmentShaderSource, shadingModes[shadingMode].define);
+    PendingProgram pendingProgram;
+    beginCompileShaders(pendingProgram, sceneVertexSource, sceneFragmentSource.c_str());
+
+    // Wait for the mesh, then for the shaders
+    bool meshLoaded = meshLoad.get();
+    GLuint shaderProgram = finishCompileShaders(pendingProgram);
+    if (!meshLoaded || shaderProgram == 0) {
+        return -1;
+    }
+
+    // Picking reports objects by their corner ranges, whether or not they get impostors
+    std::vector<SceneObject> pickObjects;
+    if (pickingEnabled) {
+        pickObjects = sceneObjects;
+    }
+
+    // Impostors only pay off with several objects; the LOD path draws the mesh as a whole
+    if (lodEnabled || sceneObjects.size() < 2 || impostorPixels <= 0.0f) {
+        sceneObjects.clear();
+    } else {
+        calculateObjectBounds(vertices);
+    }
+
+    // Compute normals on the GPU if the context allows it, otherwise fall back to the CPU
+    GLuint normalAccumulateProgram = 0, normalResolveProgram = 0;
+    if (!weldIds.empty()) {
+        if (computeShadersSupported()) {
+            normalAccumulateProgram = compileComputeShader(normalAccumulateShaderSource);
+            normalResolveProgram = compileComputeShader(normalResolveShaderSource);
+        }
+        if (normalAccumulateProgram == 0 || normalResolveProgram == 0) {
+            std::cout << "Compute shaders unavailable, calculating normals on the CPU" << std::endl;
+            std::vector<uint32_t>().swap(weldIds);
+            normals.assign(vertices.size(), glm::vec3(0.0f));
+            calculateSmoothNormals(vertices, normals);
+        }
+    }
+    bool normalsPending = !weldIds.empty();
+
+    // Draw quads as tessellated patches, or split them into triangles if the context can't
+    GLuint patchProgram = 0;
+    if (!patchVertices.empty()) {
+        if (GLEW_VERSION_4_0 || GLEW_ARB_tessellation_shader) {
+            patchProgram = compileTessellationShaders(sceneFragmentSource.c_str());
+        }
+        if (patchProgram == 0) {
+            std::cout << "Tessellation unavailable, drawing quads as triangles" << std::endl;
+            appendPatchesAsTriangles(vertices, normals, patchVertices, patchNormals);
+        }
+    }
+    uint32_t weldCount = 0;
+    for (uint32_t id : weldIds) {
+        weldCount = std::max(weldCount, id + 1);
+    }
+
+    std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - startTime;
+    std::cout << "Ready after " << startup.count() << " ms" << std::endl;
+
+    // Split the mesh into bounded-size batches, each with its own buffers and drawn with
+    // local offsets, so no single allocation or draw count grows with the mesh. The first
+    // batch is uploaded now and the rest one per frame.
+    size_t maxBatchCorners = SIZE_MAX;
+    if (vertexPulling) {
+        // Every corner is one texel of the batch's index buffer texture
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxBatchCorners = std::max<size_t>(maxTexels, 3);
+    }
+    setSceneSamplerUnits(shaderProgram);
+    setSceneSamplerUnits(patchProgram);
+
+    // The startup program is the first variant; the other shading modes compile in the
+    // background right away, so switching to them doesn't wait. The matcap and the
+    // environment's spherical harmonics are computed once.
+    ShaderVariant& startupVariant = shaderVariants[shadingModes[shadingMode].define];
+    startupVariant.defines = shadingModes[shadingMode].define;
+    startupVariant.program = shaderProgram;
+    startupVariant.patchProgram = patchProgram;
+    startupVariant.ready = true;
+    startShaderCompiler(window, sceneVertexSource, patchProgram != 0);
+    for (int m = 0; m < shadingModeCount; m++) {
+        requestShaderVariant(shadingModes[m].define);
+    }
+    int activeShadingMode = shadingMode;
+    GLuint matcapTexture = createMatcapTexture();
+    computeEnvironmentSH();
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, matcapTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Materials: texture arrays and virtual textures, and the per-corner texture coordinates
+    // selecting their layers
+    std::vector<GLuint> materialArrays;
+    std::vector<std::vector<std::pair<size_t, size_t>>> materialArrayRanges;
+    std::vector<glm::vec4> texCoords;
+    std::vector<std::pair<size_t, size_t>> transparentRanges, opaqueRanges;
+    bool virtualTexturing = false;
+    if (!materials.empty()) {
+        materialArrays = createMaterialArrays();
+        buildMaterialCorners(uvs, vertices.size(), materialArrays.size() + virtualTextures.size(), texCoords,
+                             materialArrayRanges, transparentRanges);
+        std::vector<glm::vec2>().swap(uvs);
+        std::cout << "Material texture arrays: " << materialArrays.size() << ", virtual textures: "
+                  << virtualTextures.size() << std::endl;
+        virtualTexturing = !virtualTextures.empty() && startVirtualTextures();
+    }
+    if (!transparentRanges.empty()) {
+        transparency.resolveProgram = compileShaders(transparencyResolveVertexShaderSource,
+                                                     transparencyResolveFragmentShaderSource);
+        if (transparency.resolveProgram == 0) {
+            transparentRanges.clear();
+        }
+    }
+    size_t opaqueCursor = 0;
+    for (const auto& range : transparentRanges) {
+        if (range.first > opaqueCursor) {
+            opaqueRanges.push_back(std::make_pair(opaqueCursor, range.first - opaqueCursor));
+        }
+        opaqueCursor = range.first + range.second;
+    }
+    opaqueRanges.push_back(std::make_pair(opaqueCursor, SIZE_MAX - opaqueCursor));
+    std::vector<std::pair<size_t, size_t>> passRanges;
+    std::vector<std::vector<std::pair<size_t, size_t>>> virtualMeshRanges(virtualTextures.size());
+    uint64_t frame = 0;
+    std::vector<MeshBatch> batches = planMeshBatches(vertices.size(), batchBytes, maxBatchCorners);
+    const size_t meshCorners = batches.back().first + batches.back().count;
+    uploadMeshBatch(batches[0], vertices, normals, texCoords, weldIds);
+    uploadFeatureEdges(batches[0]);
+    size_t nextUpload = 1;
+    std::cout << "Uploading " << batches.size() << " batch" << (batches.size() > 1 ? "es" : "") << std::endl;
+
+    // Patches are small coarse cages, uploaded in one go
+    GLuint patchVAO = 0, patchVBO = 0, patchNBO = 0;
+    GLsizei patchCount = (GLsizei)patchVertices.size();
+    if (patchProgram != 0) {
+        glGenVertexArrays(1, &patchVAO);
+        glBindVertexArray(patchVAO);
+
+        glGenBuffers(1, &patchVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+        glBufferData(GL_ARRAY_BUFFER, patchVertices.size() * sizeof(glm::vec3), patchVertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(0);
+
+        if (!patchNormals.empty()) {
+            glGenBuffers(1, &patchNBO);
+            glBindBuffer(GL_ARRAY_BUFFER, patchNBO);
+            glBufferData(GL_ARRAY_BUFFER, patchNormals.size() * sizeof(glm::vec3), patchNormals.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            glEnableVertexAttribArray(1);
+        }
+    }
+
+    // Calculate center and scale for model; with LOD the full-detail level is the mesh
+    const glm::vec3* meshVertices = vertices.data();
+    size_t meshVertexCount = vertices.size();
+    if (lodEnabled) {
+        meshVertices = lod.positions.data();
+        meshVertexCount = lod.baseCorners;
+    }
+    glm::vec3 center(0.0f);
+    float maxDistance = 0.0f;
+
+    for (size_t i = 0; i < meshVertexCount; i++) {
+        center += meshVertices[i];
+    }
+    for (const auto& vertex : patchVertices) {
+        center += vertex;
+    }
+    center /= (float)(meshVertexCount + patchVertices.size());
+
+    for (size_t i = 0; i < meshVertexCount; i++) {
+        float distance = glm::length(meshVertices[i] - center);
+        if (distance > maxDistance) {
+            maxDistance = distance;
+        }
+    }
+    for (const auto& vertex : patchVertices) {
+        maxDistance = std::max(maxDistance, glm::length(vertex - center));
+    }
+    std::vector<glm::vec3>().swap(patchVertices);
+    std::vector<glm::vec3>().swap(patchNormals);
+
+    // The whole hierarchy is uploaded at once; per frame only the selected clusters are drawn
+    std::vector<LODBuffer> lodBuffers;
+    std::vector<std::vector<GLint>> lodFirsts;
+    std::vector<std::vector<GLsizei>> lodCounts;
+    std::vector<std::vector<GLint>> capLODFirsts;
+    std::vector<std::vector<GLsizei>> capLODCounts;
+    if (lodEnabled) {
+        uploadLOD(lod, lodBuffers);
+    }
+
+    // Impostor atlas and the offscreen target it is baked through; objects are baked a few
+    // per frame once the whole mesh is on the GPU
+    GLuint impostorAtlas = 0, impostorBakeProgram = 0, impostorProgram = 0;
+    GLuint impostorFBO = 0, impostorDepth = 0, impostorVAO = 0, impostorVBO = 0;
+    size_t nextBake = 0;
+    if (!sceneObjects.empty()) {
+        impostorBakeProgram = compileShaders(sceneVertexSource, impostorBakeFragmentShaderSource);
+        impostorProgram = compileShaders(shaderPermutation(impostorVertexShaderSource, octahedralShaderSource).c_str(),
+                                         impostorFragmentShaderSource);
+        if (impostorBakeProgram != 0 && impostorProgram != 0) {
+            impostorAtlas = createImpostorAtlas();
+        }
+    }
+    if (impostorAtlas != 0) {
+        const int size = impostorGrid * impostorTileSize;
+        glGenRenderbuffers(1, &impostorDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, impostorDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glGenFramebuffers(1, &impostorFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, impostorFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, impostorDepth);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, impostorAtlas, 0, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Impostor framebuffer incomplete, drawing all objects as geometry" << std::endl;
+            sceneObjects.clear();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (vertexPulling) {
+            glUseProgram(impostorBakeProgram);
+            glUniform1i(glGetUniformLocation(impostorBakeProgram, "vertexIndices"), 0);
+            glUniform1i(glGetUniformLocation(impostorBakeProgram, "positions"), 1);
+            glUniform1i(glGetUniformLocation(impostorBakeProgram, "encodedNormals"), 2);
+        }
+        glUseProgram(impostorProgram);
+        glUniform1i(glGetUniformLocation(impostorProgram, "impostors"), 0);
+        glUniform1i(glGetUniformLocation(impostorProgram, "gridSize"), impostorGrid);
+
+        // One instance per impostor: bounding sphere and atlas layer
+        glGenVertexArrays(1, &impostorVAO);
+        glBindVertexArray(impostorVAO);
+        glGenBuffers(1, &impostorVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, impostorVBO);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(4 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+    }
+    std::vector<std::pair<size_t, size_t>> meshRanges;
+    std::vector<std::pair<size_t, size_t>> materialMeshRanges;
+    std::vector<float> impostorInstances;
+
+    // Feature edges are drawn from the batches' own vertices; silhouette candidates have
+    // their own compact buffer, of which only the clusters that can hold a silhouette are drawn.
+    // The solid color program also counts surfaces into the stencil for section caps.
+    GLuint solidColorProgram = compileShaders(sceneVertexSource, edgeFragmentShaderSource);
+    setSceneSamplerUnits(solidColorProgram);
+    GLuint silhouetteProgram = 0;
+    GLuint silhouetteVAO = 0, silhouetteVBO = 0;
+    std::vector<GLint> silhouetteFirsts;
+    std::vector<GLsizei> silhouetteCounts;
+    if (edgesEnabled) {
+        silhouetteProgram = silhouetteVertices.empty() ? 0 : compileSilhouetteShaders();
+    }
+    if (silhouetteProgram != 0) {
+        glGenVertexArrays(1, &silhouetteVAO);
+        glBindVertexArray(silhouetteVAO);
+        glGenBuffers(1, &silhouetteVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, silhouetteVBO);
+        glBufferData(GL_ARRAY_BUFFER, silhouetteVertices.size() * sizeof(SilhouetteVertex), silhouetteVertices.data(),
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SilhouetteVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, sizeof(SilhouetteVertex), (void*)offsetof(SilhouetteVertex, faceNormals));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+    std::vector<SilhouetteVertex>().swap(silhouetteVertices);
+
+    // Section caps: one quad per plane, rebuilt when drawn
+    GLuint sectionCapProgram = compileShaders(sectionCapVertexShaderSource, sectionCapFragmentShaderSource);
+    GLuint sectionCapVAO = 0, sectionCapVBO = 0;
+    glGenVertexArrays(1, &sectionCapVAO);
+    glBindVertexArray(sectionCapVAO);
+    glGenBuffers(1, &sectionCapVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, sectionCapVBO);
+    glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    std::vector<std::pair<size_t, size_t>> sectionRanges;
+    std::vector<std::pair<size_t, size_t>> pickRanges;
+
+    if (pickingEnabled) {
+        picking.program = compileShaders(sceneVertexSource, pickFragmentShaderSource);
+        setSceneSamplerUnits(picking.program);
+        pickingEnabled = picking.program != 0;
+    }
+    uint32_t hoveredTriangle = 0;   // 1-based, 0 for none
+    const SceneObject* hoveredObject = NULL;
+
+    // Slice polylines as model-space line segments
+    GLuint sliceProgram = 0, sliceVAO = 0, sliceVBO = 0;
+    GLsizei sliceVertexCount = 0;
+    if (!meshSlices.empty()) {
+        const int u = (sliceAxis + 1) % 3, v = (sliceAxis + 2) % 3;
+        std::vector<glm::vec3> lines;
+        for (const auto& slice : meshSlices) {
+            for (const auto& polyline : slice.polylines) {
+                size_t n = polyline.points.size();
+                for (size_t i = 0; i + 1 < n || (polyline.closed && i < n); i++) {
+                    for (const glm::vec2& point : {polyline.points[i], polyline.points[(i + 1) % n]}) {
+                        glm::vec3 position;
+                        position[sliceAxis] = slice.height;
+                        position[u] = point.x;
+                        position[v] = point.y;
+                        lines.push_back(position);
+                    }
+                }
+            }
+        }
+        sliceProgram = compileShaders(sectionCapVertexShaderSource, edgeFragmentShaderSource);
+        glGenVertexArrays(1, &sliceVAO);
+        glBindVertexArray(sliceVAO);
+        glGenBuffers(1, &sliceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, sliceVBO);
+        glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(glm::vec3), lines.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        sliceVertexCount = (GLsizei)lines.size();
+        std::vector<MeshSlice>().swap(meshSlices);
+    }
+
+    // Shadows are cast by the whole mesh at full detail, whatever is drawn on screen
+    if (shadowsEnabled && !createShadowMap()) {
+        std::cout << "Shadow map unavailable, drawing without shadows" << std::endl;
+        shadowsEnabled = false;
+    }
+    const std::vector<std::pair<size_t, size_t>> shadowRanges(1, std::make_pair((size_t)0, meshCorners));
+    std::vector<std::vector<GLint>> shadowLODFirsts(lodBuffers.size());
+    std::vector<std::vector<GLsizei>> shadowLODCounts(lodBuffers.size());
+    for (const auto& cluster : lod.clusters) {
+        if (cluster.level != 0) continue;
+        shadowLODFirsts[cluster.buffer].push_back((GLint)(cluster.firstCorner - lodBuffers[cluster.buffer].firstCorner));
+        shadowLODCounts[cluster.buffer].push_back((GLsizei)cluster.cornerCount);
+    }
+    const glm::vec3 lockedLight = lightDir;
+
+    if (nextUpload == batches.size()) {
+        releaseMeshCopies(vertices, normals, uvs);
+        std::vector<glm::vec4>().swap(texCoords);
+        std::vector<size_t>().swap(featureEdges);
+    }
+    if (nextUpload == batches.size() && normalsPending) {
+        computeNormalsGPU(batches, weldCount, normalAccumulateProgram, normalResolveProgram);
+        std::vector<uint32_t>().swap(weldIds);
+        normalsPending = false;
+    }
+
+    // Enable depth testing and multisampling
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_MULTISAMPLE);
+    
+    // Enable backface culling
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    
+    // Smooth line rendering for wireframe
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    
+    // Background color (dark gray)
+    glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+
+    // Main render loop
+    while (!glfwWindowShouldClose(window)) {
+        // Bake a few impostors per frame once the mesh and its normals are on the GPU
+        if (!sceneObjects.empty() && nextBake < sceneObjects.size() && nextUpload == batches.size() && !normalsPending) {
+            glBindFramebuffer(GL_FRAMEBUFFER, impostorFBO);
+            glUseProgram(impostorBakeProgram);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            for (int baked = 0; nextBake < sceneObjects.size() && baked < 16; nextBake++) {
+                if (sceneObjects[nextBake].layer < 0) continue;
+                bakeImpostor(impostorBakeProgram, batches, sceneObjects[nextBake], impostorAtlas);
+                baked++;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            glViewport(0, 0, width, height);
+            glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+        }
+
+        // Clear buffers
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Switch to the selected shading mode once its variant has compiled, drawing with the
+        // active one until then; a mode that fails to compile is dropped
+        if (shadingMode != activeShadingMode) {
+            ShaderVariant& variant = requestShaderVariant(shadingModes[shadingMode].define);
+            if (shaderVariantReady(variant)) {
+                if (variant.failed) {
+                    std::cerr << "Shading mode " << shadingModes[shadingMode].name << " unavailable" << std::endl;
+                    shadingMode = activeShadingMode;
+                } else {
+                    activeShadingMode = shadingMode;
+                    shaderProgram = variant.program;
+                    patchProgram = variant.patchProgram;
+                }
+            }
+        }
+
+        // Stream in the virtual texture pages requested by the last feedback
+        frame++;
+        if (virtualTexturing) {
+            updateVirtualTextures(frame);
+        }
+
+        // Take the triangle under the cursor from an earlier pick pass, if it has arrived
+        uint32_t picked;
+        if (pickingEnabled && readPickResult(picked) && picked != hoveredTriangle) {
+            hoveredTriangle = picked;
+            size_t corner = (size_t)(hoveredTriangle - 1) * 3;
+            auto object = std::upper_bound(pickObjects.begin(), pickObjects.end(), corner,
+                                           [](size_t corner, const SceneObject& object) { return corner < object.first; });
+            hoveredObject = hoveredTriangle != 0 && object != pickObjects.begin() &&
+                            corner < std::prev(object)->first + std::prev(object)->count ? &*std::prev(object) : NULL;
+            std::string title = "OBJ Viewer";
+            if (hoveredTriangle != 0) {
+                title += " - ";
+                if (hoveredObject != NULL) {
+                    title += hoveredObject->name + ", ";
+                }
+                title += "triangle " + std::to_string(hoveredTriangle - 1);
+            }
+            glfwSetWindowTitle(window, title.c_str());
+        }
+
+        // Upload one more batch per frame so huge meshes don't stall the driver
+        if (nextUpload < batches.size()) {
+            uploadMeshBatch(batches[nextUpload], vertices, normals, texCoords, weldIds);
+            uploadFeatureEdges(batches[nextUpload++]);
+            if (nextUpload == batches.size()) {
+                releaseMeshCopies(vertices, normals, uvs);
+                std::vector<glm::vec4>().swap(texCoords);
+                std::vector<size_t>().swap(featureEdges);
+            }
+            if (nextUpload == batches.size() && normalsPending) {
+                computeNormalsGPU(batches, weldCount, normalAccumulateProgram, normalResolveProgram);
+                std::vector<uint32_t>().swap(weldIds);
+                normalsPending = false;
+            }
+        }
+
+        // Create transformations
+        glm::mat4 model = glm::mat4(1.0f);
+        
+        // Apply rotations to the model
+        model = glm::rotate(model, glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+        
+        // Scale the model to fit the view
+        model = glm::scale(model, glm::vec3(1.0f / maxDistance));
+        // Center the model
+        model = glm::translate(model, -center);
+
+        // Fixed camera position looking at the center
+        glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), cameraUp);
+        
+        // Get window size
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        float aspectRatio = (float)width / (float)height;
+
+        glm::mat4 projection = glm::perspective(glm::radians(zoom), aspectRatio, 0.1f, 100.0f);
+        float pixelsPerRadian = (float)height / (2.0f * std::tan(glm::radians(zoom) * 0.5f));
+
+        // A locked light is fixed in model space and turns with the model
+        if (lockLightToModel) {
+            lightDir = glm::normalize(glm::mat3(model) * lockedLight);
+        }
+        glm::vec3 modelLight = lockLightToModel ? lockedLight : glm::normalize(glm::inverse(glm::mat3(model)) * lightDir);
+
+        // Section planes clip everything drawn from here on, shadow casters included
+        updateSectionPlanes(center, maxDistance);
+        const unsigned int sectionMask = (1u << sectionPlaneCount) - 1;
+        enableSectionPlanes(sectionMask);
+
+        // Re-render the shadow map only when the light moved relative to the model or more of
+        // the mesh arrived; zooming and, with a locked light, rotating reuse it
+        if (shadowsEnabled &&
+            (!shadow.valid || shadow.uploadedBatches != nextUpload || shadow.sectionVersion != sectionVersion ||
+             glm::dot(modelLight, shadow.direction) < 0.99999f)) {
+            beginShadowMap(modelLight, center, maxDistance);
+            glUseProgram(shaderProgram);
+            setSceneUniforms(shaderProgram, glm::mat4(1.0f), shadow.view, shadow.projection, true);
+            glUniform1i(glGetUniformLocation(shaderProgram, "shadowed"), 0);
+            if (lodEnabled) {
+                for (size_t b = 0; b < lodBuffers.size(); b++) {
+                    if (shadowLODFirsts[b].empty()) continue;
+                    glBindVertexArray(lodBuffers[b].VAO);
+                    glMultiDrawArrays(GL_TRIANGLES, shadowLODFirsts[b].data(), shadowLODCounts[b].data(),
+                                      (GLsizei)shadowLODFirsts[b].size());
+                }
+            } else {
+                drawMeshRanges(shaderProgram, batches, shadowRanges);
+            }
+            if (patchProgram != 0) {
+                glUseProgram(patchProgram);
+                setSceneUniforms(patchProgram, glm::mat4(1.0f), shadow.view, shadow.projection, true);
+                glUniform1i(glGetUniformLocation(patchProgram, "shadowed"), 0);
+                glUniform2f(glGetUniformLocation(patchProgram, "viewportSize"), (float)shadowMapSize, (float)shadowMapSize);
+                glUniform1f(glGetUniformLocation(patchProgram, "pixelsPerSegment"), 8.0f);
+                glBindVertexArray(patchVAO);
+                glPatchParameteri(GL_PATCH_VERTICES, 4);
+                glDrawArrays(GL_PATCHES, 0, patchCount);
+            }
+            endShadowMap(width, height);
+            shadow.uploadedBatches = nextUpload;
+            shadow.sectionVersion = sectionVersion;
+        }
+
+        // Use shader program
+        glUseProgram(shaderProgram);
+        setSceneUniforms(shaderProgram, model, view, projection, flatShading || normalsPending);
+        setShadowUniforms(shaderProgram, model);
+
+        // Draw the model
+        bool debugViewing = debugViewMode != 0;
+        if (showWireframe) {
+            // Wireframe rendering
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            glLineWidth(1.0f);
+        } else {
+            // Solid rendering
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        
+        const float frameErrorPixels = lodErrorPixels;
+        if (lodEnabled) {
+            // Tune the error threshold towards the triangle budget for the next frame
+            size_t selected = selectLODClusters(lod, lodBuffers, model, projection * view, pixelsPerRadian,
+                                                lodErrorPixels, sectionMask, lodFirsts, lodCounts);
+            if (lodTriangleBudget > 0) {
+                if (selected > lodTriangleBudget) {
+                    lodErrorPixels *= 1.25f;
+                } else if (selected < lodTriangleBudget * 8 / 10 && lodErrorPixels > 0.25f) {
+                    lodErrorPixels *= 0.9f;
+                }
+            }
+
+            for (size_t b = 0; b < lodBuffers.size() && !debugViewing; b++) {
+                if (lodFirsts[b].empty()) continue;
+                glBindVertexArray(lodBuffers[b].VAO);
+                glMultiDrawArrays(GL_TRIANGLES, lodFirsts[b].data(), lodCounts[b].data(), (GLsizei)lodFirsts[b].size());
+            }
+        }
+
+        // Objects that are small on screen are drawn as impostors, the rest as geometry
+        meshRanges.clear();
+        impostorInstances.clear();
+        size_t cursor = 0;
+        for (const auto& object : sceneObjects) {
+            // A sectioned object must show its inside, which its impostor doesn't have; the
+            // debug views show the cost of the full geometry
+            if (!object.baked || sectionPlaneCount > 0 || debugViewing) continue;
+            glm::vec3 center = glm::vec3(model * glm::vec4(object.center, 1.0f));
+            float distance = glm::length(center - cameraPos);
+            float radius = object.radius / maxDistance;
+            if (distance <= radius || 2.0f * radius / distance * pixelsPerRadian >= impostorPixels) continue;
+
+            if (object.first > cursor) {
+                meshRanges.push_back(std::make_pair(cursor, object.first - cursor));
+            }
+            cursor = object.first + object.count;
+            impostorInstances.insert(impostorInstances.end(),
+                                     {object.center.x, object.center.y, object.center.z, object.radius, (float)object.layer});
+        }
+        if (meshCorners > cursor) {
+            meshRanges.push_back(std::make_pair(cursor, meshCorners - cursor));
+        }
+
+        // Runs of the mesh that the section planes remove entirely are not submitted
+        if (sectionPlaneCount > 0) {
+            selectSectionRanges(sectionMask, sectionRanges);
+            intersectRanges(meshRanges, sectionRanges, passRanges);
+            meshRanges.swap(passRanges);
+        }
+        // One pass per texture array, then per virtual texture; corners without a material
+        // use the default color
+        for (auto& ranges : virtualMeshRanges) {
+            ranges.clear();
+        }
+        auto drawMaterials = [&](const std::vector<std::pair<size_t, size_t>>& ranges) {
+            glActiveTexture(GL_TEXTURE3);
+            for (size_t a = 0; a < materialArrayRanges.size(); a++) {
+                intersectRanges(ranges, materialArrayRanges[a], materialMeshRanges);
+                bool textured = a < materialArrays.size();
+                bool virtualTextured = virtualTexturing && !textured && a < materialArrays.size() + virtualTextures.size();
+                if (virtualTextured) {
+                    std::vector<std::pair<size_t, size_t>>& pageRanges = virtualMeshRanges[a - materialArrays.size()];
+                    pageRanges.insert(pageRanges.end(), materialMeshRanges.begin(), materialMeshRanges.end());
+                    bindVirtualTexture(shaderProgram, (int)(a - materialArrays.size()));
+                }
+                if (materialMeshRanges.empty()) continue;
+                glBindTexture(GL_TEXTURE_2D_ARRAY, textured ? materialArrays[a] : 0);
+                glUniform1i(glGetUniformLocation(shaderProgram, "textured"), textured);
+                glUniform1i(glGetUniformLocation(shaderProgram, "virtualTextured"), virtualTextured);
+                drawMeshRanges(shaderProgram, batches, materialMeshRanges);
+            }
+            glActiveTexture(GL_TEXTURE0);
+        };
+        if (debugViewing) {
+            // With --lod, index order is the triangles' order in the hierarchy, cluster by cluster
+            size_t debugTriangles = meshCorners / 3;
+            if (lodEnabled && !lod.clusters.empty()) {
+                debugTriangles = (lod.clusters.back().firstCorner + lod.clusters.back().cornerCount) / 3;
+            }
+            GLuint debugProgram = beginDebugView(sceneVertexSource, width, height, model, view, projection, debugTriangles);
+            if (lodEnabled) {
+                for (size_t b = 0; b < lodBuffers.size(); b++) {
+                    if (lodFirsts[b].empty()) continue;
+                    glUniform1ui(glGetUniformLocation(debugProgram, "batchFirstTriangle"), (GLuint)(lodBuffers[b].firstCorner / 3));
+                    glBindVertexArray(lodBuffers[b].VAO);
+                    glMultiDrawArrays(GL_TRIANGLES, lodFirsts[b].data(), lodCounts[b].data(), (GLsizei)lodFirsts[b].size());
+                }
+            } else {
+                drawMeshRanges(debugProgram, batches, meshRanges);
+            }
+            endDebugView(width, height);
+        } else if (materialArrayRanges.empty()) {
+            drawMeshRanges(shaderProgram, batches, meshRanges);
+        } else if (transparentRanges.empty()) {
+            drawMaterials(meshRanges);
+        } else {
+            intersectRanges(meshRanges, opaqueRanges, passRanges);
+            drawMaterials(passRanges);
+        }
+
+        if (!impostorInstances.empty()) {
+            glUseProgram(impostorProgram);
+            setSceneUniforms(impostorProgram, model, view, projection, false);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, impostorAtlas);
+            glBindVertexArray(impostorVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, impostorVBO);
+            glBufferData(GL_ARRAY_BUFFER, impostorInstances.size() * sizeof(float), impostorInstances.data(), GL_STREAM_DRAW);
+            glDisable(GL_CULL_FACE);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(impostorInstances.size() / 5));
+            glEnable(GL_CULL_FACE);
+        }
+
+        if (patchProgram != 0 && !debugViewing) {
+            glUseProgram(patchProgram);
+            setSceneUniforms(patchProgram, model, view, projection, flatShading);
+            setShadowUniforms(patchProgram, model);
+            glUniform2f(glGetUniformLocation(patchProgram, "viewportSize"), (float)width, (float)height);
+            glUniform1f(glGetUniformLocation(patchProgram, "pixelsPerSegment"), 8.0f);
+            glBindVertexArray(patchVAO);
+            glPatchParameteri(GL_PATCH_VERTICES, 4);
+            glDrawArrays(GL_PATCHES, 0, patchCount);
+        }
+
+        // Cap each section: with only its own plane clipping, every opaque surface behind the
+        // plane toggles the stencil, leaving an odd count where the plane cuts through the
+        // inside; the cap quad is drawn there, clipped by the other planes. Surfaces are
+        // counted from the runs this plane alone leaves, so the parity stays exact.
+        if (sectionPlaneCount > 0 && capSections && !showWireframe && !debugViewing) {
+            glEnable(GL_STENCIL_TEST);
+            glDisable(GL_CULL_FACE);
+            for (int p = 0; p < sectionPlaneCount; p++) {
+                glClear(GL_STENCIL_BUFFER_BIT);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glDepthMask(GL_FALSE);
+                glDisable(GL_DEPTH_TEST);
+                glStencilFunc(GL_ALWAYS, 0, 1);
+                glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+                enableSectionPlanes(1u << p);
+
+                glUseProgram(solidColorProgram);
+                setSceneUniforms(solidColorProgram, model, view, projection, false);
+                if (lodEnabled) {
+                    // Same threshold as the frame, so the same levels, culled by this plane only
+                    selectLODClusters(lod, lodBuffers, model, projection * view, pixelsPerRadian,
+                                      frameErrorPixels, 1u << p, capLODFirsts, capLODCounts);
+                    for (size_t b = 0; b < lodBuffers.size(); b++) {
+                        if (capLODFirsts[b].empty()) continue;
+                        glBindVertexArray(lodBuffers[b].VAO);
+                        glMultiDrawArrays(GL_TRIANGLES, capLODFirsts[b].data(), capLODCounts[b].data(),
+                                          (GLsizei)capLODFirsts[b].size());
+                    }
+                } else {
+                    selectSectionRanges(1u << p, sectionRanges);
+                    intersectRanges(opaqueRanges, sectionRanges, passRanges);
+                    drawMeshRanges(solidColorProgram, batches, passRanges);
+                }
+                if (patchProgram != 0) {
+                    glUseProgram(patchProgram);
+                    glBindVertexArray(patchVAO);
+                    glDrawArrays(GL_PATCHES, 0, patchCount);
+                }
+
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glDepthMask(GL_TRUE);
+                glEnable(GL_DEPTH_TEST);
+                glStencilFunc(GL_EQUAL, 1, 1);
+                glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+                enableSectionPlanes(sectionMask & ~(1u << p));
+                glUseProgram(sectionCapProgram);
+                setSceneUniforms(sectionCapProgram, model, view, projection, false);
+                glm::vec3 capNormal = glm::normalize(glm::mat3(model) * -glm::vec3(sectionPlanes[p]));
+                glUniform3fv(glGetUniformLocation(sectionCapProgram, "capNormal"), 1, glm::value_ptr(capNormal));
+                glUniform3fv(glGetUniformLocation(sectionCapProgram, "capColor"), 1, glm::value_ptr(sectionCapColor));
+                glBindVertexArray(sectionCapVAO);
+                drawSectionCap(sectionCapVBO, p, center, maxDistance);
+            }
+            glDisable(GL_STENCIL_TEST);
+            glEnable(GL_CULL_FACE);
+            enableSectionPlanes(sectionMask);
+        }
+
+        // The hovered object, tinted over its shading
+        if (hoveredObject != NULL && !showWireframe && !debugViewing) {
+            pickRanges.assign(1, std::make_pair(hoveredObject->first, hoveredObject->count));
+            intersectRanges(meshRanges, pickRanges, passRanges);
+            glUseProgram(solidColorProgram);
+            setSceneUniforms(solidColorProgram, model, view, projection, false);
+            glUniform3fv(glGetUniformLocation(solidColorProgram, "edgeColor"), 1, glm::value_ptr(highlightColor));
+            glDepthMask(GL_FALSE);
+            glDepthFunc(GL_LEQUAL);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+            glBlendColor(0.0f, 0.0f, 0.0f, 0.35f);
+            drawMeshRanges(solidColorProgram, batches, passRanges);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDisable(GL_BLEND);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+
+        // Feature edges and silhouettes over the opaque surfaces
+        if (showEdges && edgesEnabled && !debugViewing) {
+            glUseProgram(solidColorProgram);
+            setSceneUniforms(solidColorProgram, model, view, projection, false);
+            glUniform3fv(glGetUniformLocation(solidColorProgram, "edgeColor"), 1, glm::value_ptr(edgeColor));
+            drawFeatureEdges(solidColorProgram, batches);
+        }
+        if (showEdges && silhouetteProgram != 0 && !debugViewing) {
+            glm::vec3 modelCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+            selectSilhouetteClusters(modelCamera, silhouetteFirsts, silhouetteCounts);
+            if (!silhouetteFirsts.empty()) {
+                glUseProgram(silhouetteProgram);
+                glUniformMatrix4fv(glGetUniformLocation(silhouetteProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+                glUniformMatrix4fv(glGetUniformLocation(silhouetteProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+                glUniformMatrix4fv(glGetUniformLocation(silhouetteProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+                glUniform3fv(glGetUniformLocation(silhouetteProgram, "modelCamera"), 1, glm::value_ptr(modelCamera));
+                glUniform3fv(glGetUniformLocation(silhouetteProgram, "positionOrigin"), 1, glm::value_ptr(silhouetteOrigin));
+                glUniform3fv(glGetUniformLocation(silhouetteProgram, "positionExtent"), 1, glm::value_ptr(silhouetteExtent));
+                glUniform3fv(glGetUniformLocation(silhouetteProgram, "edgeColor"), 1, glm::value_ptr(edgeColor));
+                glBindVertexArray(silhouetteVAO);
+                glMultiDrawArrays(GL_LINES, silhouetteFirsts.data(), silhouetteCounts.data(), (GLsizei)silhouetteFirsts.size());
+            }
+        }
+
+        if (showSlices && sliceProgram != 0 && !debugViewing) {
+            glUseProgram(sliceProgram);
+            setSceneUniforms(sliceProgram, model, view, projection, false);
+            glUniform3fv(glGetUniformLocation(sliceProgram, "edgeColor"), 1, glm::value_ptr(sliceColor));
+            glBindVertexArray(sliceVAO);
+            glDrawArrays(GL_LINES, 0, sliceVertexCount);
+        }
+
+        // Translucent materials last, in one unsorted pass against the opaque depth: both
+        // sides are drawn and nothing writes depth
+        intersectRanges(meshRanges, transparentRanges, passRanges);
+        if (!passRanges.empty() && !debugViewing) {
+            glUseProgram(shaderProgram);
+            if (!beginTransparency(width, height)) {
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glDisable(GL_BLEND);
+                intersectRanges(meshRanges, opaqueRanges, materialMeshRanges);
+                drawMeshRanges(shaderProgram, batches, materialMeshRanges);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glEnable(GL_BLEND);
+            }
+            glDepthMask(GL_FALSE);
+            glDisable(GL_CULL_FACE);
+            glUniform1i(glGetUniformLocation(shaderProgram, "transparencyPass"), 1);
+            drawMaterials(passRanges);
+            glUniform1i(glGetUniformLocation(shaderProgram, "transparencyPass"), 0);
+            enableSectionPlanes(0);
+            resolveTransparency(width, height);
+            enableSectionPlanes(sectionMask);
+        }
+
+        // IDs of the geometry around the cursor, read back in a later frame
+        if (pickingEnabled) {
+            double cursorX, cursorY;
+            int windowWidth, windowHeight;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            int x = (int)(cursorX * width / std::max(windowWidth, 1));
+            int y = height - 1 - (int)(cursorY * height / std::max(windowHeight, 1));
+            if (x >= 0 && y >= 0 && x < width && y < height) {
+                renderPickIds(batches, meshRanges, pickObjects, model, view, projection, width, height, x, y);
+            }
+        }
+
+        // Every few frames, find the virtual texture pages the view needs
+        if (virtualTexturing && frame % virtualFeedbackInterval == 0) {
+            renderVirtualFeedback(batches, virtualMeshRanges, model, view, projection, width, height);
+        }
+        enableSectionPlanes(0);
+        
+        // Reset polygon mode for next frame if needed
+        if (showWireframe) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        
+        // Swap buffers and poll events
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    // Clean up
+    for (auto& batch : batches) {
+        glDeleteVertexArrays(1, &batch.VAO);
+        glDeleteBuffers(1, &batch.VBO);
+        glDeleteBuffers(1, &batch.NBO);
+        glDeleteBuffers(1, &batch.TBO);
+        glDeleteBuffers(1, &batch.IBO);
+        glDeleteBuffers(1, &batch.EBO);
+        glDeleteTextures(3, batch.textures);
+    }
+    for (auto& buffer : lodBuffers) {
+        glDeleteVertexArrays(1, &buffer.VAO);
+        glDeleteBuffers(1, &buffer.VBO);
+        glDeleteBuffers(1, &buffer.NBO);
+    }
+    glDeleteTextures((GLsizei)materialArrays.size(), materialArrays.data());
+    glDeleteTextures(1, &impostorAtlas);
+    glDeleteFramebuffers(1, &impostorFBO);
+    glDeleteRenderbuffers(1, &impostorDepth);
+    glDeleteVertexArrays(1, &impostorVAO);
+    glDeleteBuffers(1, &impostorVBO);
+    glDeleteProgram(impostorBakeProgram);
+    glDeleteProgram(impostorProgram);
+    stopShaderCompiler();
+    glDeleteTextures(1, &matcapTexture);
+    glDeleteProgram(solidColorProgram);
+    glDeleteProgram(silhouetteProgram);
+    glDeleteVertexArrays(1, &silhouetteVAO);
+    glDeleteBuffers(1, &silhouetteVBO);
+    glDeleteProgram(sectionCapProgram);
+    glDeleteProgram(sliceProgram);
+    glDeleteVertexArrays(1, &sliceVAO);
+    glDeleteBuffers(1, &sliceVBO);
+    glDeleteVertexArrays(1, &sectionCapVAO);
+    glDeleteBuffers(1, &sectionCapVBO);
+    glDeleteVertexArrays(1, &patchVAO);
+    glDeleteBuffers(1, &patchVBO);
+    glDeleteBuffers(1, &patchNBO);
+    glDeleteProgram(normalAccumulateProgram);
+    glDeleteProgram(normalResolveProgram);
+    if (virtualTexturing) {
+        stopVirtualTextures();
+    }
+    destroyTransparency();
+    destroyPicking();
+    destroyDebugView();
+    glDeleteFramebuffers(1, &shadow.fbo);
+    glDeleteTextures(1, &shadow.depth);
+    closeZipArchive(bundleArchive);
+
+    glfwTerminate();
+    return 0;
+}
+
+// 64-bit FNV-1a hash, used for cache keys
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashString(const std::string& text, uint64_t hash = 14695981039346656037ull) {
+    // Hash the terminator too so that concatenated fields can't collide
+    return hashBytes(text.c_str(), text.size() + 1, hash);
+}
+
+// Per-user cache directory for shader binaries and other derived data, empty if unavailable
+std::string cacheDirectory() {
+    std::string dir;
+    if (const char* env = getenv("OBJ_VIEWER_CACHE")) {
+        dir = env;
+    } else if (const char* xdg = getenv("XDG_CACHE_HOME")) {
+        dir = std::string(xdg) + "/obj-viewer";
+    } else if (const char* local = getenv("LOCALAPPDATA")) {
+        dir = std::string(local) + "/obj-viewer";
+    } else if (const char* home = getenv("HOME")) {
+        dir = std::string(home) + "/.cache/obj-viewer";
+    } else {
+        return "";
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return ec ? "" : dir;
+}
+
+// Cache file for a program built from the given sources by the current driver
+std::string programCachePath(const char* vertexSource, const char* fragmentSource) {
+    std::string dir = cacheDirectory();
+    if (dir.empty()) return "";
+
+    uint64_t hash = hashString((const char*)glGetString(GL_VENDOR));
+    hash = hashString((const char*)glGetString(GL_RENDERER), hash);
+    hash = hashString((const char*)glGetString(GL_VERSION), hash);
+    hash = hashString(vertexSource, hash);
+    hash = hashString(fragmentSource, hash);
+
+    char name[40];
+    snprintf(name, sizeof(name), "program-%016llx.bin", (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+bool programBinariesSupported() {
+    if (!useShaderCache || !GLEW_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// Returns a linked program from the binary cache, or 0 if there is no usable entry
+GLuint loadCachedProgram(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return 0;
+
+    GLenum format = 0;
+    file.read((char*)&format, sizeof(format));
+    if (!file) return 0;
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+
+    // Drivers reject binaries after updates; drop the stale entry and recompile
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        std::remove(path.c_str());
+        return 0;
+    }
+    return program;
+}
+
+// Writes a file through `writer` under a temporary name, then renames it over `path`, so
+// concurrent viewers never read a partial file. False if any step fails.
+bool replaceFileAtomically(const std::string& path, const std::function<void(std::ofstream&)>& writer) {
+#ifdef _WIN32
+    std::string temporary = path + ".tmp" + std::to_string(GetCurrentProcessId());
+#else
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+#endif
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file.is_open()) return false;
+        writer(file);
+        if (!file.good()) {
+            file.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) std::remove(temporary.c_str());
+    return !ec;
+}
+
+void saveCachedProgram(const std::string& path, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+    replaceFileAtomically(path, [&](std::ofstream& file) {
+        file.write((const char*)&format, sizeof(format));
+        file.write(binary.data(), binary.size());
+    });
+}
+
+// Source with `defines` inserted after its #version line
+std::string shaderPermutation(const char* source, const char* defines) {
+    std::string permutation = source;
+    size_t version = permutation.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : permutation.find('\n', version);
+    permutation.insert(lineEnd == std::string::npos ? 0 : lineEnd + 1, defines);
+    return permutation;
+}
+
+// Runs variant compiles on the shared context; the fence tells the main context when the
+// program objects are complete
+void shaderCompilerWorker() {
+    glfwMakeContextCurrent(shaderCompiler.context);
+    std::unique_lock<std::mutex> lock(shaderCompiler.mutex);
+    while (true) {
+        shaderCompiler.changed.wait(lock, [] { return shaderCompiler.stopping || !shaderCompiler.jobs.empty(); });
+        if (shaderCompiler.stopping) break;
+        std::string defines = shaderCompiler.jobs.front();
+        shaderCompiler.jobs.pop_front();
+        lock.unlock();
+
+        std::string fragmentSource = shaderPermutation(fragmentShaderSource, defines.c_str());
+        GLuint program = compileShaders(shaderCompiler.vertexSource, fragmentSource.c_str());
+        GLuint patchProgram = 0;
+        if (program != 0 && shaderCompiler.tessellation) {
+            patchProgram = compileTessellationShaders(fragmentSource.c_str());
+        }
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        lock.lock();
+        ShaderVariant& variant = shaderVariants[defines];
+        variant.program = program;
+        variant.patchProgram = patchProgram;
+        variant.fence = fence;
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
+// Picks how variants compile: through the driver's parallel compile when it can report
+// completion, otherwise on a worker thread with a shared context, otherwise synchronously
+void startShaderCompiler(GLFWwindow* window, const char* vertexSource, bool tessellation) {
+    shaderCompiler.vertexSource = vertexSource;
+    shaderCompiler.tessellation = tessellation;
+    shaderCompiler.driverParallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    if (shaderCompiler.driverParallel) return;
+
+    shaderCompiler.context = createWindow(glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MAJOR),
+                                          glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MINOR), window);
+    glfwMakeContextCurrent(window);
+    if (shaderCompiler.context != NULL) {
+        shaderCompiler.worker = std::thread(shaderCompilerWorker);
+    }
+}
+
+void stopShaderCompiler() {
+    if (shaderCompiler.worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(shaderCompiler.mutex);
+            shaderCompiler.stopping = true;
+        }
+        shaderCompiler.changed.notify_all();
+        shaderCompiler.worker.join();
+    }
+    if (shaderCompiler.context != NULL) {
+        glfwDestroyWindow(shaderCompiler.context);
+    }
+    for (auto& entry : shaderVariants) {
+        ShaderVariant& variant = entry.second;
+        if (variant.fence != 0) {
+            glDeleteSync(variant.fence);
+        }
+        glDeleteProgram(variant.program);
+        glDeleteProgram(variant.patchProgram);
+    }
+    shaderVariants.clear();
+}
+
+// Returns the variant with `defines`, starting its compile if it is new
+ShaderVariant& requestShaderVariant(const std::string& defines) {
+    std::unique_lock<std::mutex> lock(shaderCompiler.mutex);
+    ShaderVariant& variant = shaderVariants[defines];
+    if (variant.ready || variant.compiling) {
+        return variant;
+    }
+    variant.defines = defines;
+    variant.compiling = true;
+
+    if (shaderCompiler.worker.joinable()) {
+        shaderCompiler.jobs.push_back(defines);
+        lock.unlock();
+        shaderCompiler.changed.notify_all();
+    } else if (shaderCompiler.driverParallel) {
+        std::string fragmentSource = shaderPermutation(fragmentShaderSource, defines.c_str());
+        beginCompileShaders(variant.pending, shaderCompiler.vertexSource, fragmentSource.c_str());
+    }
+    return variant;
+}
+
+// Polls a requested variant without blocking (except without any background compilation);
+// once it reports ready, `failed` tells whether it can be used
+bool shaderVariantReady(ShaderVariant& variant) {
+    if (variant.ready) return true;
+
+    if (shaderCompiler.worker.joinable()) {
+        std::lock_guard<std::mutex> lock(shaderCompiler.mutex);
+        if (variant.fence == 0) return false;
+        GLenum status = glClientWaitSync(variant.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        glDeleteSync(variant.fence);
+        variant.fence = 0;
+    }
+
+    std::string fragmentSource = shaderPermutation(fragmentShaderSource, variant.defines.c_str());
+    if (shaderCompiler.driverParallel) {
+        if (variant.pending.vertexShader != 0) {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(variant.pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete) return false;
+        }
+        variant.program = finishCompileShaders(variant.pending);
+        if (variant.program != 0 && shaderCompiler.tessellation) {
+            variant.patchProgram = compileTessellationShaders(fragmentSource.c_str());
+        }
+    } else if (!shaderCompiler.worker.joinable()) {
+        variant.program = compileShaders(shaderCompiler.vertexSource, fragmentSource.c_str());
+        if (variant.program != 0 && shaderCompiler.tessellation) {
+            variant.patchProgram = compileTessellationShaders(fragmentSource.c_str());
+        }
+    }
+
+    variant.compiling = false;
+    variant.ready = true;
+    variant.failed = variant.program == 0 || (shaderCompiler.tessellation && variant.patchProgram == 0);
+    setSceneSamplerUnits(variant.program);
+    setSceneSamplerUnits(variant.patchProgram);
+    return true;
+}
+
+GLuint compileShaders(const char* vertexSource, const char* fragmentSource) {
+    PendingProgram pending;
+    beginCompileShaders(pending, vertexSource, fragmentSource);
+    return finishCompileShaders(pending);
+}
+
+// Issues the compile and link without querying their status, so drivers with parallel
+// shader compile can finish the work in the background
+void beginCompileShaders(PendingProgram& pending, const char* vertexSource, const char* fragmentSource) {
+    // Reuse the driver's compiled program from a previous launch when possible
+    bool cacheBinaries = programBinariesSupported();
+    pending.cachePath = cacheBinaries ? programCachePath(vertexSource, fragmentSource) : "";
+    if (!pending.cachePath.empty()) {
+        pending.program = loadCachedProgram(pending.cachePath);
+        if (pending.program != 0) {
+            return;
+        }
+    }
+
+    // Vertex shader
+    pending.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertexShader, 1, &vertexSource, NULL);
+    glCompileShader(pending.vertexShader);
+
+    // Fragment shader
+    pending.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.fragmentShader, 1, &fragmentSource, NULL);
+    glCompileShader(pending.fragmentShader);
+
+    // Link shaders
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertexShader);
+    glAttachShader(pending.program, pending.fragmentShader);
+    if (!pending.cachePath.empty()) {
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(pending.program);
+}
+
+// Waits for a program started by beginCompileShaders() and reports errors; returns 0 on failure
+GLuint finishCompileShaders(PendingProgram& pending) {
+    if (pending.vertexShader == 0) {
+        // Loaded from the binary cache
+        return pending.program;
+    }
+
+    GLuint vertexShader = pending.vertexShader;
+    GLuint fragmentShader = pending.fragmentShader;
+    GLuint shaderProgram = pending.program;
+
+    // Check for compilation errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        return 0;
+    }
+
+    // Check for compilation errors
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        return 0;
+    }
+
+    // Check for linking errors
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        return 0;
+    }
+
+    // Delete the shaders as they're linked into our program now and no longer necessary
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    if (!pending.cachePath.empty()) {
+        saveCachedProgram(pending.cachePath, shaderProgram);
+    }
+
+    return shaderProgram;
+}
+
+struct VertexKey {
+    glm::vec3 position;
+    
+    bool operator<(const VertexKey& other) const {
+        if (position.x != other.position.x) return position.x < other.position.x;
+        if (position.y != other.position.y) return position.y < other.position.y;
+        return position.z < other.position.z;
+    }
+
+    bool operator==(const VertexKey& other) const {
+        return position == other.position;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // Adding 0 turns -0.0 into +0.0, which compares equal
+        glm::vec3 position = key.position + glm::vec3(0.0f);
+        return (size_t)hashBytes(&position, sizeof(position));
+    }
+};
+
+// Parsed OBJ records shared by the full and the partial (indexed) loaders
+struct OBJParseState {
+    std::vector<glm::vec3> temp_vertices;
+    std::vector<glm::vec2> temp_uvs;
+    std::vector<glm::vec3> temp_normals;
+    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    std::vector<unsigned int> patchVertexIndices, patchUVIndices, patchNormalIndices;
+
+    // Number of v/vt/vn records that precede temp_* in the file (non-zero for partial loads)
+    size_t vertexBase = 0;
+    size_t uvBase = 0;
+    size_t normalBase = 0;
+
+    // `o` and `usemtl` records with the number of triangle corners parsed before each
+    std::vector<std::pair<std::string, size_t>> objectStarts;
+    std::vector<std::pair<std::string, size_t>> materialStarts;
+
+    // Current `o`/`g` names and the `mtllib` files referenced so far
+    std::string currentObject;
+    std::string currentGroup;
+    std::vector<std::string> materialLibraries;
+};
+
+// Byte range and element-count prefixes of one `o`/`g` block of an OBJ file
+struct OBJIndexBlock {
+    std::string objectName;
+    std::string groupName;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+
+    // v/vt/vn records that precede the block, and the `usemtl` material active where it starts
+    size_t vertexPrefix = 0;
+    size_t uvPrefix = 0;
+    size_t normalPrefix = 0;
+    std::string material;
+};
+
+// Byte range of consecutive v (kind 0), vt (1) or vn (2) lines, at most objIndexRunRecords
+// of them, following `first` records of the same kind
+struct OBJIndexRun {
+    int kind = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    size_t first = 0;
+    size_t count = 0;
+};
+
+// Sidecar index written next to the OBJ file (<file>.idx) after a full load
+struct OBJIndex {
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    std::vector<OBJIndexBlock> blocks;
+    std::vector<OBJIndexRun> runs;
+    std::vector<std::string> materialLibraries;
+};
+
+std::string objIndexPath(const char* path) {
+    return std::string(path) + ".idx";
+}
+
+bool objSourceStamp(const char* path, uint64_t& size, int64_t& time) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    time = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+// Converts an OBJ index token (absolute or negative/relative) to an absolute 1-based index, 0 if invalid
+unsigned int resolveOBJIndex(const std::string& token, size_t count) {
+    long long index = std::stoll(token);
+    if (index < 0) {
+        index += (long long)count + 1;
+    }
+    return index > 0 ? (unsigned int)index : 0;
+}
+
+// Returns the name following an `o`/`g` prefix, without trailing whitespace
+std::string objRecordName(const std::string& line, const std::string& prefix) {
+    size_t start = line.find(prefix) + prefix.size();
+    size_t first = line.find_first_not_of(" \t", start);
+    if (first == std::string::npos) return "";
+    size_t last = line.find_last_not_of(" \t\r\n");
+    return line.substr(first, last - first + 1);
+}
+
+// Parses one OBJ line into the state and returns its record prefix (`v`, `f`, `o`, ...)
+std::string parseOBJLine(const std::string& line, OBJParseState& state, bool parseFaces) {
+    std::istringstream iss(line);
+    std::string prefix;
+    iss >> prefix;
+
+    if (prefix == "v") {
+        glm::vec3 vertex;
+        iss >> vertex.x >> vertex.y >> vertex.z;
+        state.temp_vertices.push_back(vertex);
+    } else if (prefix == "vt") {
+        glm::vec2 uv;
+        iss >> uv.x >> uv.y;
+        state.temp_uvs.push_back(uv);
+    } else if (prefix == "vn") {
+        glm::vec3 normal;
+        iss >> normal.x >> normal.y >> normal.z;
+        state.temp_normals.push_back(normal);
+    } else if (prefix == "f" && parseFaces) {
+        std::string vertex1, vertex2, vertex3;
+        iss >> vertex1 >> vertex2 >> vertex3;
         
-        // Apply rotations to the model
-        model = glm::rotate(model, glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+        // Handle faces with more than 3 vertices (triangulation)
+        std::string vertex4;
+        iss >> vertex4;
+        bool isQuad = !vertex4.empty();
         
-        // Scale the model to fit the view
-        model = glm::scale(model, glm::vec3(1.0f / maxDistance));
-        // Center the model
-        model = glm::translate(model, -center);
+        std::vector<std::string> face_vertices;
+        face_vertices.push_back(vertex1);
+        face_vertices.push_back(vertex2);
+        face_vertices.push_back(vertex3);
+        
+        // Quads are kept whole as tessellation patches when requested
+        bool asPatch = isQuad && keepQuadPatches;
+        if (asPatch) {
+            face_vertices.push_back(vertex4);
+        } else if (isQuad) {
+            // For quads, add another triangle
+            face_vertices.push_back(vertex1); // Reuse vertex1
+            face_vertices.push_back(vertex3); // Reuse vertex3
+            face_vertices.push_back(vertex4);
+        }
+        std::vector<unsigned int>& vertexIndices = asPatch ? state.patchVertexIndices : state.vertexIndices;
+        std::vector<unsigned int>& uvIndices = asPatch ? state.patchUVIndices : state.uvIndices;
+        std::vector<unsigned int>& normalIndices = asPatch ? state.patchNormalIndices : state.normalIndices;
+
+        // Totals so far, used to resolve relative (negative) indices
+        size_t vertexCount = state.vertexBase + state.temp_vertices.size();
+        size_t uvCount = state.uvBase + state.temp_uvs.size();
+        size_t normalCount = state.normalBase + state.temp_normals.size();
+        
+        // Process each corner of the face's triangles (or patch)
+        for (size_t i = 0; i < face_vertices.size(); i++) {
+            std::string vertex = face_vertices[i];
+            std::istringstream viss(vertex);
+            std::string token;
+            
+            // Parse vertex index
+            std::getline(viss, token, '/');
+            unsigned int vertexIndex = resolveOBJIndex(token, vertexCount);
+            vertexIndices.push_back(vertexIndex);
+            
+            // Parse texture coordinate index (if present), keeping the arrays aligned
+            unsigned int uvIndex = 0;
+            if (std::getline(viss, token, '/') && !token.empty()) {
+                uvIndex = resolveOBJIndex(token, uvCount);
+            }
+            uvIndices.push_back(uvIndex);
+            
+            // Parse normal index (if present)
+            unsigned int normalIndex = 0;
+            if (std::getline(viss, token, '/') && !token.empty()) {
+                normalIndex = resolveOBJIndex(token, normalCount);
+            }
+            normalIndices.push_back(normalIndex);
+        }
+    } else if (prefix == "o") {
+        state.objectStarts.push_back(std::make_pair(objRecordName(line, prefix), state.vertexIndices.size()));
+    } else if (prefix == "usemtl") {
+        state.materialStarts.push_back(std::make_pair(objRecordName(line, prefix), state.vertexIndices.size()));
+    } else if (prefix == "mtllib") {
+        std::string name;
+        while (iss >> name) {
+            state.materialLibraries.push_back(name);
+        }
+    }
+
+    return prefix;
+}
+
+// Expands the parsed faces into flat per-corner arrays, and the quad patches into 4 corners each
+void buildOBJOutput(const OBJParseState& state,
+                    std::vector<glm::vec3>& out_vertices, 
+                    std::vector<glm::vec3>& out_normals, 
+                    std::vector<glm::vec2>& out_uvs,
+                    std::vector<glm::vec3>& out_patchVertices,
+                    std::vector<glm::vec3>& out_patchNormals) {
+    const size_t vertexEnd = state.vertexBase + state.temp_vertices.size();
+    const size_t uvEnd = state.uvBase + state.temp_uvs.size();
+    const size_t normalEnd = state.normalBase + state.temp_normals.size();
+
+    out_vertices.reserve(out_vertices.size() + state.vertexIndices.size());
+
+    // Objects and material assignments become corner ranges of the output
+    size_t nextObject = 0;
+    auto closeObject = [&]() {
+        if (!sceneObjects.empty() && sceneObjects.back().count == SIZE_MAX) {
+            sceneObjects.back().count = out_vertices.size() - sceneObjects.back().first;
+            if (sceneObjects.back().count == 0) sceneObjects.pop_back();
+        }
+    };
+    size_t nextMaterial = 0;
+    auto closeMaterial = [&]() {
+        if (!materialRanges.empty() && materialRanges.back().count == SIZE_MAX) {
+            materialRanges.back().count = out_vertices.size() - materialRanges.back().first;
+            if (materialRanges.back().count == 0) materialRanges.pop_back();
+        }
+    };
+    materialLibraries.insert(materialLibraries.end(), state.materialLibraries.begin(), state.materialLibraries.end());
+
+    // Process vertex indices (OBJ uses 1-based indexing)
+    for (size_t i = 0; i < state.vertexIndices.size(); i++) {
+        while (nextObject < state.objectStarts.size() && state.objectStarts[nextObject].second <= i) {
+            closeObject();
+            SceneObject object;
+            object.name = state.objectStarts[nextObject++].first;
+            object.first = out_vertices.size();
+            object.count = SIZE_MAX;
+            sceneObjects.push_back(object);
+        }
+        while (nextMaterial < state.materialStarts.size() && state.materialStarts[nextMaterial].second <= i) {
+            closeMaterial();
+            MaterialRange range;
+            range.name = state.materialStarts[nextMaterial++].first;
+            range.first = out_vertices.size();
+            range.count = SIZE_MAX;
+            materialRanges.push_back(range);
+        }
+
+        size_t vertexIndex = state.vertexIndices[i];
+        if (vertexIndex > state.vertexBase && vertexIndex <= vertexEnd) {
+            glm::vec3 vertex = state.temp_vertices[vertexIndex - state.vertexBase - 1];
+            out_vertices.push_back(vertex);
+            
+            // Process texture coordinates if available
+            size_t uvIndex = state.uvIndices[i];
+            if (uvIndex > state.uvBase && uvIndex <= uvEnd) {
+                out_uvs.push_back(state.temp_uvs[uvIndex - state.uvBase - 1]);
+            } else if (!state.temp_uvs.empty()) {
+                out_uvs.push_back(glm::vec2(0.0f, 0.0f));
+            }
+            
+            // Process normals if available
+            size_t normalIndex = state.normalIndices[i];
+            if (normalIndex > state.normalBase && normalIndex <= normalEnd) {
+                out_normals.push_back(state.temp_normals[normalIndex - state.normalBase - 1]);
+            }
+        }
+    }
+    closeObject();
+    closeMaterial();
+
+    // Quad patches, skipping any with an unresolved corner
+    for (size_t i = 0; i + 3 < state.patchVertexIndices.size(); i += 4) {
+        bool valid = true;
+        for (size_t k = i; k < i + 4; k++) {
+            size_t vertexIndex = state.patchVertexIndices[k];
+            valid = valid && vertexIndex > state.vertexBase && vertexIndex <= vertexEnd;
+        }
+        if (!valid) continue;
+
+        for (size_t k = i; k < i + 4; k++) {
+            out_patchVertices.push_back(state.temp_vertices[state.patchVertexIndices[k] - state.vertexBase - 1]);
+            size_t normalIndex = state.patchNormalIndices[k];
+            if (normalIndex > state.normalBase && normalIndex <= normalEnd) {
+                out_patchNormals.push_back(state.temp_normals[normalIndex - state.normalBase - 1]);
+            }
+        }
+    }
+}
+
+bool writeOBJIndex(const char* path, const OBJIndex& index) {
+    std::ofstream file(objIndexPath(path));
+    if (!file.is_open()) {
+        std::cerr << "Cannot write OBJ index: " << objIndexPath(path) << std::endl;
+        return false;
+    }
+
+    file << "# OBJ Viewer index\n";
+    file << "version " << objIndexVersion << "\n";
+    file << "source " << index.sourceSize << " " << index.sourceTime << "\n";
+    for (const auto& library : index.materialLibraries) {
+        file << "mtllib " << library << "\n";
+    }
+    for (const auto& block : index.blocks) {
+        file << "block " << block.begin << " " << block.end << " "
+             << block.vertexPrefix << " " << block.uvPrefix << " " << block.normalPrefix << "\n";
+        file << "object " << block.objectName << "\n";
+        file << "group " << block.groupName << "\n";
+        file << "material " << block.material << "\n";
+    }
+    for (const auto& run : index.runs) {
+        file << "run " << run.kind << " " << run.begin << " " << run.end << " " << run.first << " " << run.count << "\n";
+    }
+    if (!file.good()) {
+        std::cerr << "Cannot write OBJ index: " << objIndexPath(path) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Whether the sidecar index exists and was written for the OBJ file as it is now
+bool objIndexCurrent(const char* path) {
+    std::ifstream file(objIndexPath(path));
+    uint64_t size = 0;
+    int64_t time = 0;
+    if (!file.is_open() || !objSourceStamp(path, size, time)) {
+        return false;
+    }
+
+    int version = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix;
+        iss >> prefix;
+        if (prefix == "version") {
+            iss >> version;
+        } else if (prefix == "source") {
+            uint64_t sourceSize = 0;
+            int64_t sourceTime = 0;
+            iss >> sourceSize >> sourceTime;
+            return version == objIndexVersion && sourceSize == size && sourceTime == time;
+        }
+    }
+    return false;
+}
+
+// Writes the index built by a full parse unless writing is disabled or an up-to-date one
+// exists. A failed write is reported and otherwise ignored: the caller keeps the index in
+// memory, and the next partial load just parses the file again.
+void updateOBJIndex(const char* path, OBJIndex& index) {
+    if (!writeOBJIndexFile || index.blocks.empty() || objIndexCurrent(path)) return;
+    if (objSourceStamp(path, index.sourceSize, index.sourceTime)) {
+        writeOBJIndex(path, index);
+    }
+}
+
+// Reads the sidecar index, failing if it is missing or older than the OBJ file
+bool readOBJIndex(const char* path, OBJIndex& index) {
+    std::ifstream file(objIndexPath(path));
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint64_t size = 0;
+    int64_t time = 0;
+    if (!objSourceStamp(path, size, time)) {
+        return false;
+    }
+
+    int version = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix;
+        iss >> prefix;
+
+        if (prefix == "version") {
+            iss >> version;
+        } else if (prefix == "source") {
+            iss >> index.sourceSize >> index.sourceTime;
+        } else if (prefix == "mtllib") {
+            index.materialLibraries.push_back(objRecordName(line, prefix));
+        } else if (prefix == "block") {
+            OBJIndexBlock block;
+            iss >> block.begin >> block.end
+                >> block.vertexPrefix >> block.uvPrefix >> block.normalPrefix;
+            index.blocks.push_back(block);
+        } else if (prefix == "object" && !index.blocks.empty()) {
+            index.blocks.back().objectName = objRecordName(line, prefix);
+        } else if (prefix == "group" && !index.blocks.empty()) {
+            index.blocks.back().groupName = objRecordName(line, prefix);
+        } else if (prefix == "material" && !index.blocks.empty()) {
+            index.blocks.back().material = objRecordName(line, prefix);
+        } else if (prefix == "run") {
+            OBJIndexRun run;
+            iss >> run.kind >> run.begin >> run.end >> run.first >> run.count;
+            if (run.kind < 0 || run.kind > 2) return false;
+            index.runs.push_back(run);
+        }
+    }
+
+    return version == objIndexVersion && index.sourceSize == size && index.sourceTime == time && !index.blocks.empty();
+}
+
+bool mapFile(const char* path, MappedFile& mapped) {
+#ifdef _WIN32
+    mapped.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mapped.file, &size);
+    mapped.size = (size_t)size.QuadPart;
+    if (mapped.size == 0) return true;
+    mapped.mapping = CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapped.mapping == NULL) return false;
+    mapped.data = (const char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    return mapped.data != NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    mapped.size = (size_t)info.st_size;
+    if (mapped.size > 0) {
+        void* data = mmap(NULL, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        // The OBJ and zip readers walk the mapping front to back
+        madvise(data, mapped.size, MADV_SEQUENTIAL);
+        mapped.data = (const char*)data;
+    }
+    close(fd);
+    return true;
+#endif
+}
+
+void unmapFile(MappedFile& mapped) {
+#ifdef _WIN32
+    if (mapped.data) UnmapViewOfFile(mapped.data);
+    if (mapped.mapping) CloseHandle(mapped.mapping);
+    if (mapped.file != INVALID_HANDLE_VALUE) CloseHandle(mapped.file);
+    mapped.mapping = NULL;
+    mapped.file = INVALID_HANDLE_VALUE;
+#else
+    if (mapped.data) munmap((void*)mapped.data, mapped.size);
+#endif
+    mapped.data = NULL;
+    mapped.size = 0;
+}
+
+// Parses the complete lines in [data, data + size) that start at file offset `baseOffset`.
+// Unless `final` is set, a trailing line without a newline is left unparsed; the number
+// of bytes consumed is returned so chunked callers can carry the remainder over.
+size_t parseOBJLines(const char* data, size_t size, uint64_t baseOffset, bool final,
+                     OBJParseState& state, OBJIndex* index) {
+    size_t pos = 0;
+    std::string line;
+    while (pos < size) {
+        const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+        if (newline == NULL && !final) {
+            break;
+        }
+        size_t lineEnd = newline ? (size_t)(newline - data) : size;
+        uint64_t lineBegin = baseOffset + pos;
+        line.assign(data + pos, lineEnd - pos);
+        pos = newline ? lineEnd + 1 : size;
+
+        size_t vertexCount = state.vertexBase + state.temp_vertices.size();
+        size_t uvCount = state.uvBase + state.temp_uvs.size();
+        size_t normalCount = state.normalBase + state.temp_normals.size();
+
+        std::string prefix = parseOBJLine(line, state, true);
+
+        // Consecutive v/vt/vn lines are indexed in runs, so a partial load can find its records
+        int kind = prefix == "v" ? 0 : prefix == "vt" ? 1 : prefix == "vn" ? 2 : -1;
+        if (index != NULL && kind >= 0) {
+            OBJIndexRun* run = index->runs.empty() ? NULL : &index->runs.back();
+            if (run != NULL && run->kind == kind && run->end == lineBegin && run->count < objIndexRunRecords) {
+                run->end = baseOffset + pos;
+                run->count++;
+            } else {
+                OBJIndexRun next;
+                next.kind = kind;
+                next.begin = lineBegin;
+                next.end = baseOffset + pos;
+                next.first = kind == 0 ? vertexCount : kind == 1 ? uvCount : normalCount;
+                next.count = 1;
+                index->runs.push_back(next);
+            }
+        }
+
+        if (prefix == "o" || prefix == "g") {
+            // Each `o`/`g` record starts a new index block
+            if (prefix == "o") {
+                state.currentObject = objRecordName(line, prefix);
+                state.currentGroup.clear();
+            } else {
+                state.currentGroup = objRecordName(line, prefix);
+            }
+            if (index == NULL) continue;
+
+            if (!index->blocks.empty()) {
+                index->blocks.back().end = lineBegin;
+            }
+            OBJIndexBlock block;
+            block.objectName = state.currentObject;
+            block.groupName = state.currentGroup;
+            block.begin = lineBegin;
+            block.vertexPrefix = vertexCount;
+            block.uvPrefix = uvCount;
+            block.normalPrefix = normalCount;
+            block.material = state.materialStarts.empty() ? "" : state.materialStarts.back().first;
+            index->blocks.push_back(block);
+        }
+    }
+    return pos;
+}
+
+// Closes the last index block at the end of the parsed data
+void finishOBJIndex(OBJIndex& index, OBJParseState& state, uint64_t end) {
+    if (!index.blocks.empty()) {
+        index.blocks.back().end = std::max<uint64_t>(end, index.blocks.back().begin);
+    }
+    index.materialLibraries = state.materialLibraries;
+}
+
+bool loadOBJ(const char* path, 
+             std::vector<glm::vec3>& out_vertices, 
+             std::vector<glm::vec3>& out_normals, 
+             std::vector<glm::vec2>& out_uvs) {
+    
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot open file: " << path << std::endl;
+        unmapFile(file);
+        return false;
+    }
+
+    OBJParseState state;
+    OBJIndex index;
+    parseOBJLines(file.data, file.size, 0, true, state, &index);
+    finishOBJIndex(index, state, file.size);
+    unmapFile(file);
+
+    buildOBJOutput(state, out_vertices, out_normals, out_uvs, patchVertices, patchNormals);
+
+    // Record the block layout so later loads can parse a single object
+    updateOBJIndex(path, index);
+    return true;
+}
+
+// Builds the index of an OBJ file with a full parse, without producing any geometry
+bool buildOBJIndex(const char* path, OBJIndex& index) {
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot open file: " << path << std::endl;
+        unmapFile(file);
+        return false;
+    }
+
+    OBJParseState state;
+    parseOBJLines(file.data, file.size, 0, true, state, &index);
+    finishOBJIndex(index, state, file.size);
+    unmapFile(file);
+    updateOBJIndex(path, index);
+    return true;
+}
+
+uint16_t readLE16(const char* p) {
+    const unsigned char* b = (const unsigned char*)p;
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+uint32_t readLE32(const char* p) {
+    return (uint32_t)readLE16(p) | ((uint32_t)readLE16(p + 2) << 16);
+}
+
+uint64_t readLE64(const char* p) {
+    return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void closeZipArchive(ZipArchive& archive) {
+    unmapFile(archive.file);
+    archive.entries.clear();
+    archive.byName.clear();
+}
+
+bool openZipArchive(const char* path, ZipArchive& archive) {
+    if (!mapFile(path, archive.file)) {
+        std::cerr << "Cannot open archive: " << path << std::endl;
+        closeZipArchive(archive);
+        return false;
+    }
+    const char* data = archive.file.data;
+    const size_t size = archive.file.size;
+
+    // The end of central directory record sits within the last 64 KB (its comment is at most 65535 bytes)
+    const size_t eocdSize = 22;
+    size_t eocd = SIZE_MAX;
+    for (size_t pos = size >= eocdSize ? size - eocdSize + 1 : 0; pos-- > 0 && size - pos <= eocdSize + 65535;) {
+        if (readLE32(data + pos) == 0x06054b50) {
+            eocd = pos;
+            break;
+        }
+    }
+    if (eocd == SIZE_MAX) {
+        std::cerr << "Not a zip archive: " << path << std::endl;
+        closeZipArchive(archive);
+        return false;
+    }
+
+    uint64_t entryCount = readLE16(data + eocd + 10);
+    uint64_t directorySize = readLE32(data + eocd + 12);
+    uint64_t directoryOffset = readLE32(data + eocd + 16);
+
+    // Archives over 4 GB or 65535 entries store the real values in the ZIP64 record
+    if (eocd >= 20 && readLE32(data + eocd - 20) == 0x07064b50) {
+        uint64_t eocd64 = readLE64(data + eocd - 20 + 8);
+        if (size >= 56 && eocd64 <= size - 56 && readLE32(data + eocd64) == 0x06064b50) {
+            entryCount = readLE64(data + eocd64 + 32);
+            directorySize = readLE64(data + eocd64 + 40);
+            directoryOffset = readLE64(data + eocd64 + 48);
+        }
+    }
+
+    if (directoryOffset > size || directorySize > size - directoryOffset) {
+        std::cerr << "Corrupt zip central directory: " << path << std::endl;
+        closeZipArchive(archive);
+        return false;
+    }
+
+    // Every record, with its variable-length fields, must lie within the directory
+    size_t pos = (size_t)directoryOffset;
+    const size_t directoryEnd = (size_t)(directoryOffset + directorySize);
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (directoryEnd - pos < 46 || readLE32(data + pos) != 0x02014b50 ||
+            directoryEnd - pos - 46 < (size_t)readLE16(data + pos + 28) + readLE16(data + pos + 30) + readLE16(data + pos + 32)) {
+            std::cerr << "Corrupt zip central directory: " << path << std::endl;
+            closeZipArchive(archive);
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.flags = readLE16(data + pos + 8);
+        entry.method = readLE16(data + pos + 10);
+        entry.compressedSize = readLE32(data + pos + 20);
+        entry.size = readLE32(data + pos + 24);
+        uint16_t nameLength = readLE16(data + pos + 28);
+        uint16_t extraLength = readLE16(data + pos + 30);
+        uint16_t commentLength = readLE16(data + pos + 32);
+        entry.localHeaderOffset = readLE32(data + pos + 42);
+        entry.name.assign(data + pos + 46, nameLength);
+
+        // ZIP64 extended information replaces the fields saturated at 0xFFFFFFFF, in this order
+        const char* extra = data + pos + 46 + nameLength;
+        const char* extraEnd = extra + extraLength;
+        while (extra + 4 <= extraEnd) {
+            uint16_t id = readLE16(extra);
+            uint16_t length = readLE16(extra + 2);
+            const char* field = extra + 4;
+            if (length > extraEnd - field) break;
+            if (id == 0x0001) {
+                if (entry.size == 0xFFFFFFFF && field + 8 <= extraEnd) { entry.size = readLE64(field); field += 8; }
+                if (entry.compressedSize == 0xFFFFFFFF && field + 8 <= extraEnd) { entry.compressedSize = readLE64(field); field += 8; }
+                if (entry.localHeaderOffset == 0xFFFFFFFF && field + 8 <= extraEnd) { entry.localHeaderOffset = readLE64(field); }
+            }
+            extra += 4 + length;
+        }
+
+        archive.byName[entry.name] = archive.entries.size();
+        archive.entries.push_back(entry);
+        pos += 46 + nameLength + extraLength + commentLength;
+    }
+
+    return true;
+}
+
+// Returns the entry's compressed bytes inside the mapping, or NULL if the local header is invalid
+const char* zipEntryData(const ZipArchive& archive, const ZipEntry& entry) {
+    const size_t size = archive.file.size;
+    if (size < 30 || entry.localHeaderOffset > size - 30) return NULL;
+
+    const char* header = archive.file.data + entry.localHeaderOffset;
+    if (readLE32(header) != 0x04034b50) return NULL;
+
+    uint64_t dataOffset = entry.localHeaderOffset + 30 + readLE16(header + 26) + readLE16(header + 28);
+    if (dataOffset > size || entry.compressedSize > size - dataOffset) return NULL;
+    return archive.file.data + dataOffset;
+}
+
+// Inflates a deflated entry in fixed-size chunks, handing each one to `consume`
+bool inflateZipEntry(const ZipArchive& archive, const ZipEntry& entry,
+                     const std::function<bool(const char*, size_t)>& consume) {
+    const char* compressed = zipEntryData(archive, entry);
+    if (compressed == NULL) return false;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) return false;
+
+    const size_t chunkSize = 4 << 20;
+    std::vector<char> chunk(chunkSize);
+    uint64_t remaining = entry.compressedSize;
+    const char* input = compressed;
+    int result = Z_OK;
+
+    while (result != Z_STREAM_END) {
+        if (stream.avail_in == 0 && remaining > 0) {
+            uInt feed = (uInt)std::min<uint64_t>(remaining, 1u << 30);
+            stream.next_in = (Bytef*)input;
+            stream.avail_in = feed;
+            input += feed;
+            remaining -= feed;
+        }
+        stream.next_out = (Bytef*)chunk.data();
+        stream.avail_out = (uInt)chunkSize;
+
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END) break;
+
+        size_t produced = chunkSize - stream.avail_out;
+        if (produced > 0 && !consume(chunk.data(), produced)) {
+            result = Z_DATA_ERROR;
+            break;
+        }
+        if (produced == 0 && stream.avail_in == 0 && remaining == 0 && result != Z_STREAM_END) break;
+    }
+
+    inflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+// Reads a whole entry: stored entries point into the mapping, deflated ones are inflated into `out.storage`
+bool readZipEntry(const ZipArchive& archive, const ZipEntry& entry, AssetData& out) {
+    if (entry.flags & 1) {
+        std::cerr << "Encrypted zip entries are not supported: " << entry.name << std::endl;
+        return false;
+    }
+    if (entry.method == 0) {
+        if (entry.size != entry.compressedSize) return false;
+        out.data = zipEntryData(archive, entry);
+        out.size = (size_t)entry.size;
+        return out.data != NULL;
+    }
+    if (entry.method != 8) {
+        std::cerr << "Unsupported zip compression method " << entry.method << ": " << entry.name << std::endl;
+        return false;
+    }
+
+    out.storage.clear();
+    out.storage.reserve((size_t)entry.size);
+    bool ok = inflateZipEntry(archive, entry, [&](const char* chunk, size_t size) {
+        out.storage.insert(out.storage.end(), chunk, chunk + size);
+        return true;
+    });
+    out.data = out.storage.data();
+    out.size = out.storage.size();
+    if (!ok) std::cerr << "Failed to inflate zip entry: " << entry.name << std::endl;
+    return ok;
+}
+
+// Directory part of a path, including the trailing separator
+std::string parentPath(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Joins an MTL/texture reference to the directory of the file referencing it, resolving `.` and `..`
+std::string resolveAssetPath(const std::string& baseDir, std::string reference) {
+    std::replace(reference.begin(), reference.end(), '\\', '/');
+    bool absolute = !reference.empty() && (reference[0] == '/' || (reference.size() > 1 && reference[1] == ':'));
+    std::string joined = absolute ? reference : baseDir + reference;
+
+    std::vector<std::string> parts;
+    std::istringstream iss(joined);
+    std::string part;
+    while (std::getline(iss, part, '/')) {
+        if (part.empty() || part == ".") continue;
+        if (part == ".." && !parts.empty() && parts.back() != "..") {
+            parts.pop_back();
+        } else {
+            parts.push_back(part);
+        }
+    }
+
+    std::string resolved = (!joined.empty() && joined[0] == '/') ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++) {
+        resolved += (i > 0 ? "/" : "") + parts[i];
+    }
+    return resolved;
+}
+
+// Finds the archive entry for a resolved path, falling back to a case-insensitive file name match
+const ZipEntry* findZipEntry(const ZipArchive& archive, const std::string& path) {
+    auto it = archive.byName.find(path);
+    if (it != archive.byName.end()) return &archive.entries[it->second];
+
+    std::string fileName = toLower(path.substr(path.find_last_of('/') + 1));
+    for (const auto& entry : archive.entries) {
+        std::string entryName = toLower(entry.name.substr(entry.name.find_last_of('/') + 1));
+        if (entryName == fileName) return &entry;
+    }
+    return NULL;
+}
+
+// Texture references (`map_Kd`, `bump`, ...) of an MTL file; options precede the file name
+void collectMTLTextures(const char* data, size_t size, std::vector<std::string>& textures) {
+    std::istringstream file(std::string(data, size));
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix, token, last;
+        iss >> prefix;
+        if (prefix.rfind("map_", 0) != 0 && prefix != "bump" && prefix != "disp" &&
+            prefix != "decal" && prefix != "refl" && prefix != "norm") {
+            continue;
+        }
+        while (iss >> token) last = token;
+        if (!last.empty()) textures.push_back(last);
+    }
+}
+
+// Reads an asset referenced by the model (MTL file or texture) from the open bundle or the
+// filesystem; results are cached, so each asset is read or inflated only once
+const AssetData* findAsset(const std::string& baseDir, const std::string& reference) {
+    std::string path = resolveAssetPath(baseDir, reference);
+    const ZipEntry* entry = NULL;
+    if (bundleArchive.file.data != NULL) {
+        entry = findZipEntry(bundleArchive, path);
+        if (entry == NULL) {
+            std::cerr << "Asset not found in bundle: " << path << std::endl;
+            return NULL;
+        }
+        path = entry->name;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(assetCacheMutex);
+        auto it = assetCache.find(path);
+        if (it != assetCache.end()) return &it->second;
+    }
+
+    AssetData asset;
+    if (entry != NULL) {
+        if (!readZipEntry(bundleArchive, *entry, asset)) return NULL;
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open asset: " << path << std::endl;
+            return NULL;
+        }
+        asset.storage.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        asset.data = asset.storage.data();
+        asset.size = asset.storage.size();
+    }
+
+    std::lock_guard<std::mutex> lock(assetCacheMutex);
+    auto inserted = assetCache.emplace(path, std::move(asset));
+    return &inserted.first->second;
+}
+
+// Reads an MTL library and, in parallel, every texture it references
+void prefetchMaterialLibrary(const std::string& baseDir, const std::string& library) {
+    const AssetData* mtl = findAsset(baseDir, library);
+    if (mtl == NULL) return;
+
+    std::vector<std::string> textures;
+    collectMTLTextures(mtl->data, mtl->size, textures);
+
+    std::string mtlDir = parentPath(resolveAssetPath(baseDir, library));
+    std::vector<std::future<const AssetData*>> reads;
+    for (const auto& texture : textures) {
+        reads.push_back(std::async(std::launch::async, findAsset, mtlDir, texture));
+    }
+    for (auto& read : reads) {
+        read.get();
+    }
+}
+
+// Converts `count` pixels of an 8-bit image with the given channel layout to RGBA
+void expandToRGBA(const unsigned char* src, size_t count, int channels, unsigned char* dst) {
+    for (size_t i = 0; i < count; i++, src += channels, dst += 4) {
+        if (channels >= 3) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        } else {
+            dst[0] = dst[1] = dst[2] = src[0];
+        }
+        dst[3] = channels == 4 ? src[3] : channels == 2 ? src[1] : 255;
+    }
+}
+
+// Decodes a non-interlaced PNG of any bit depth and color type to 8-bit RGBA
+bool decodePNG(const char* data, size_t size, Image& image) {
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (size < 8 || memcmp(data, signature, 8) != 0) return false;
+
+    uint32_t width = 0, height = 0;
+    int bitDepth = 0, colorType = 0, interlace = 0;
+    std::vector<unsigned char> palette, paletteAlpha, compressed;
+    for (size_t pos = 8; pos + 12 <= size;) {
+        const unsigned char* p = (const unsigned char*)data + pos;
+        uint32_t length = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        if (length > size - pos - 12) return false;
+        std::string type((const char*)p + 4, 4);
+        const unsigned char* chunk = p + 8;
+
+        if (type == "IHDR" && length >= 13) {
+            width = (chunk[0] << 24) | (chunk[1] << 16) | (chunk[2] << 8) | chunk[3];
+            height = (chunk[4] << 24) | (chunk[5] << 16) | (chunk[6] << 8) | chunk[7];
+            bitDepth = chunk[8];
+            colorType = chunk[9];
+            interlace = chunk[12];
+        } else if (type == "PLTE") {
+            palette.assign(chunk, chunk + length);
+        } else if (type == "tRNS") {
+            paletteAlpha.assign(chunk, chunk + length);
+        } else if (type == "IDAT") {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        } else if (type == "IEND") {
+            break;
+        }
+        pos += length + 12;
+    }
+    static const int channelCounts[7] = {1, 0, 3, 1, 2, 0, 4};
+    if (width == 0 || height == 0 || interlace != 0 || colorType > 6 || channelCounts[colorType] == 0) {
+        return false;
+    }
+    // Gray takes 1, 2, 4, 8 or 16 bits, palettes up to 8 and the other types 8 or 16
+    bool validDepth = bitDepth == 8 || (bitDepth == 16 && colorType != 3) ||
+                      ((bitDepth == 1 || bitDepth == 2 || bitDepth == 4) && (colorType == 0 || colorType == 3));
+    if (!validDepth) return false;
+
+    const int channels = channelCounts[colorType];
+    const size_t bitsPerPixel = (size_t)channels * bitDepth;
+    const size_t stride = (width * bitsPerPixel + 7) / 8;
+    const size_t bpp = std::max<size_t>(bitsPerPixel / 8, 1);
+    std::vector<unsigned char> raw(height * (stride + 1));
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) return false;
+    stream.next_in = compressed.data();
+    stream.avail_in = (uInt)compressed.size();
+    stream.next_out = raw.data();
+    stream.avail_out = (uInt)raw.size();
+    int status = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END && stream.avail_out != 0) return false;
+
+    // Undo the per-row filters in place
+    std::vector<unsigned char> previous(stride, 0);
+    for (uint32_t y = 0; y < height; y++) {
+        unsigned char filter = raw[y * (stride + 1)];
+        unsigned char* row = &raw[y * (stride + 1) + 1];
+        for (size_t x = 0; x < stride; x++) {
+            int left = x >= bpp ? row[x - bpp] : 0;
+            int up = previous[x];
+            int upLeft = x >= bpp ? previous[x - bpp] : 0;
+            switch (filter) {
+                case 1: row[x] += left; break;
+                case 2: row[x] += up; break;
+                case 3: row[x] += (left + up) / 2; break;
+                case 4: {
+                    int estimate = left + up - upLeft;
+                    int dl = std::abs(estimate - left), du = std::abs(estimate - up), dul = std::abs(estimate - upLeft);
+                    row[x] += (dl <= du && dl <= dul) ? left : (du <= dul ? up : upLeft);
+                    break;
+                }
+            }
+        }
+        memcpy(previous.data(), row, stride);
+    }
+
+    image.width = (int)width;
+    image.height = (int)height;
+    image.pixels.resize((size_t)width * height * 4);
+    std::vector<unsigned char> samples((size_t)width * channels);
+    for (uint32_t y = 0; y < height; y++) {
+        const unsigned char* row = &raw[y * (stride + 1) + 1];
+
+        // Reduce every sample to 8 bits: high byte of 16-bit ones, scaled up for 1/2/4-bit
+        for (size_t i = 0; i < (size_t)width * channels; i++) {
+            if (bitDepth == 8) {
+                samples[i] = row[i];
+            } else if (bitDepth == 16) {
+                samples[i] = row[2 * i];
+            } else {
+                int value = (row[i * bitDepth / 8] >> (8 - bitDepth - (i * bitDepth) % 8)) & ((1 << bitDepth) - 1);
+                samples[i] = colorType == 3 ? (unsigned char)value : (unsigned char)(value * 255 / ((1 << bitDepth) - 1));
+            }
+        }
+
+        unsigned char* dst = &image.pixels[(size_t)y * width * 4];
+        if (colorType == 3) {
+            for (uint32_t x = 0; x < width; x++) {
+                size_t index = samples[x];
+                for (int c = 0; c < 3; c++) {
+                    dst[4 * x + c] = 3 * index + c < palette.size() ? palette[3 * index + c] : 0;
+                }
+                dst[4 * x + 3] = index < paletteAlpha.size() ? paletteAlpha[index] : 255;
+            }
+        } else {
+            expandToRGBA(samples.data(), width, channels, dst);
+        }
+    }
+    return true;
+}
+
+// Decodes an uncompressed or RLE TGA (8-bit gray, 24- or 32-bit color) to 8-bit RGBA
+bool decodeTGA(const char* data, size_t size, Image& image) {
+    const unsigned char* p = (const unsigned char*)data;
+    if (size < 18) return false;
+    int imageType = p[2];
+    int width = p[12] | (p[13] << 8);
+    int height = p[14] | (p[15] << 8);
+    int bytes = p[16] / 8;
+    bool topDown = (p[17] & 0x20) != 0;
+    bool gray = imageType == 3 || imageType == 11;
+    bool rle = imageType == 10 || imageType == 11;
+    if (p[1] != 0 || (imageType != 2 && imageType != 3 && !rle) || width == 0 || height == 0 ||
+        (gray ? bytes != 1 : bytes != 3 && bytes != 4)) {
+        return false;
+    }
+
+    // Expand to plain pixels in file order
+    const size_t count = (size_t)width * height;
+    std::vector<unsigned char> pixels(count * bytes);
+    size_t pos = 18 + p[0];
+    for (size_t i = 0; i < count;) {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle) {
+            if (pos >= size) return false;
+            run = (p[pos] & 0x7F) + 1;
+            repeat = (p[pos++] & 0x80) != 0;
+        }
+        run = std::min(run, count - i);
+        size_t needed = repeat ? bytes : run * bytes;
+        if (pos + needed > size) return false;
+        for (size_t k = 0; k < run; k++, i++) {
+            memcpy(&pixels[i * bytes], &p[pos + (repeat ? 0 : k * bytes)], bytes);
+        }
+        pos += needed;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(count * 4);
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = &pixels[(size_t)(topDown ? y : height - 1 - y) * width * bytes];
+        unsigned char* dst = &image.pixels[(size_t)y * width * 4];
+        expandToRGBA(src, width, bytes, dst);
+        if (!gray) {
+            for (int x = 0; x < width; x++) std::swap(dst[4 * x], dst[4 * x + 2]);
+        }
+    }
+    return true;
+}
+
+// Decodes a texture by content (PNG) or extension (TGA). Other formats are not supported.
+bool decodeImage(const std::string& path, const AssetData& asset, Image& image) {
+    if (decodePNG(asset.data, asset.size, image)) return true;
+    if (endsWith(toLower(path), ".tga") && decodeTGA(asset.data, asset.size, image)) return true;
+    std::cerr << "Unsupported or corrupt texture (PNG and TGA are supported): " << path << std::endl;
+    return false;
+}
+
+// Halves an image with a box filter, used when it exceeds the texture size limit
+void halveImage(Image& image) {
+    int width = std::max(image.width / 2, 1), height = std::max(image.height / 2, 1);
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) {
+                int sum = 0;
+                for (int k = 0; k < 4; k++) {
+                    int sx = std::min(2 * x + (k & 1), image.width - 1);
+                    int sy = std::min(2 * y + (k >> 1), image.height - 1);
+                    sum += image.pixels[((size_t)sy * image.width + sx) * 4 + c];
+                }
+                pixels[((size_t)y * width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    image.width = width;
+    image.height = height;
+    image.pixels.swap(pixels);
+}
+
+// Compresses one 4x4 RGBA block to BC1 colors (4-color mode): endpoints are the inset
+// bounding box of the block's colors, each pixel takes the nearest palette entry
+void encodeBC1Block(const unsigned char* block, unsigned char* out) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min<int>(lo[c], block[4 * i + c]);
+            hi[c] = std::max<int>(hi[c], block[4 * i + c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        int inset = (hi[c] - lo[c]) / 16;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    auto pack565 = [](const int* rgb) {
+        return (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+    };
+    uint16_t c0 = pack565(hi), c1 = pack565(lo);
+    if (c0 < c1) std::swap(c0, c1);
+
+    int palette[4][3];
+    for (int e = 0; e < 2; e++) {
+        uint16_t c = e == 0 ? c0 : c1;
+        palette[e][0] = ((c >> 11) & 31) * 255 / 31;
+        palette[e][1] = ((c >> 5) & 63) * 255 / 63;
+        palette[e][2] = (c & 31) * 255 / 31;
+    }
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16 && c0 != c1; i++) {
+        int best = 0, bestDistance = INT_MAX;
+        for (int e = 0; e < 4; e++) {
+            int distance = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = block[4 * i + c] - palette[e][c];
+                distance += d * d;
+            }
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = e;
+            }
+        }
+        indices |= (uint32_t)best << (2 * i);
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for (int k = 0; k < 4; k++) out[4 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+// Compresses the alpha of one 4x4 RGBA block to a BC3 alpha block (8-value mode)
+void encodeBC3AlphaBlock(const unsigned char* block, unsigned char* out) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max<int>(a0, block[4 * i + 3]);
+        a1 = std::min<int>(a1, block[4 * i + 3]);
+    }
+
+    int values[8] = {a0, a1};
+    for (int k = 1; k < 7; k++) {
+        values[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16 && a0 != a1; i++) {
+        int best = 0;
+        for (int e = 1; e < 8; e++) {
+            if (std::abs(block[4 * i + 3] - values[e]) < std::abs(block[4 * i + 3] - values[best])) best = e;
+        }
+        indices |= (uint64_t)best << (3 * i);
+    }
+
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int k = 0; k < 6; k++) out[2 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+bool textureCompressionSupported() {
+    return compressTextures && GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+}
+
+// Bytes of one level of a BC1 (8 bytes per 4x4 block) or BC3 (16 bytes) texture
+size_t compressedLevelSize(GLenum format, int width, int height) {
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ? 8 : 16);
+}
+
+// Replaces the decoded image with a BC1 (opaque) or BC3 mip chain; partial blocks at the
+// edges repeat the last row and column
+void compressTexture(MaterialTexture& texture) {
+    Image level = texture.image;
+    bool alpha = false;
+    for (size_t i = 3; i < level.pixels.size() && !alpha; i += 4) {
+        alpha = level.pixels[i] < 255;
+    }
+    texture.format = alpha ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    texture.levels.clear();
+
+    unsigned char block[64];
+    while (true) {
+        std::vector<unsigned char> data(compressedLevelSize(texture.format, level.width, level.height));
+        unsigned char* out = data.data();
+        for (int by = 0; by < level.height; by += 4) {
+            for (int bx = 0; bx < level.width; bx += 4) {
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(bx + i % 4, level.width - 1);
+                    int y = std::min(by + i / 4, level.height - 1);
+                    memcpy(&block[4 * i], &level.pixels[((size_t)y * level.width + x) * 4], 4);
+                }
+                if (alpha) {
+                    encodeBC3AlphaBlock(block, out);
+                    out += 8;
+                }
+                encodeBC1Block(block, out);
+                out += 8;
+            }
+        }
+        texture.levels.push_back(std::move(data));
+        if (level.width == 1 && level.height == 1) break;
+        halveImage(level);
+    }
+    std::vector<unsigned char>().swap(texture.image.pixels);
+}
+
+// Cache file for the compressed form of a texture with the given contents
+std::string textureCachePath(uint64_t sourceHash) {
+    std::string dir = cacheDirectory();
+    if (dir.empty()) return "";
+
+    char name[40];
+    snprintf(name, sizeof(name), "texture-%016llx.bin", (unsigned long long)sourceHash);
+    return dir + "/" + name;
+}
+
+const char textureCacheMagic[8] = {'O', 'B', 'J', 'T', 'E', 'X', '1', '\0'};
+
+bool readTextureCache(const std::string& path, MaterialTexture& texture) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    const uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    char magic[8];
+    uint32_t header[4];
+    file.read(magic, sizeof(magic));
+    file.read((char*)header, sizeof(header));
+    if (!file || memcmp(magic, textureCacheMagic, sizeof(magic)) != 0) return false;
+
+    // Only what compressTexture writes is accepted: BC1 or BC3 with the full mip chain;
+    // anything else is a damaged file and the texture is encoded again
+    const GLenum format = header[0];
+    const int width = (int)header[1], height = (int)header[2];
+    int levelCount = 1;
+    while ((std::max(width, height) >> levelCount) > 0) levelCount++;
+    if ((format != GL_COMPRESSED_SRGB_S3TC_DXT1_EXT && format != GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT) ||
+        header[1] == 0 || header[2] == 0 || header[1] > 65536 || header[2] > 65536 || (int)header[3] != levelCount) {
+        return false;
+    }
+    uint64_t expectedSize = sizeof(magic) + sizeof(header);
+    for (int level = 0; level < levelCount; level++) {
+        expectedSize += compressedLevelSize(format, std::max(width >> level, 1), std::max(height >> level, 1));
+    }
+    if (expectedSize != fileSize) return false;
+
+    std::vector<std::vector<unsigned char>> levels(levelCount);
+    for (int level = 0; level < levelCount; level++) {
+        levels[level].resize(compressedLevelSize(format, std::max(width >> level, 1), std::max(height >> level, 1)));
+        file.read((char*)levels[level].data(), levels[level].size());
+    }
+    if (!file) return false;
+
+    texture.format = format;
+    texture.image.width = width;
+    texture.image.height = height;
+    texture.levels.swap(levels);
+    return true;
+}
+
+void writeTextureCache(const std::string& path, const MaterialTexture& texture) {
+    if (path.empty()) return;
+
+    replaceFileAtomically(path, [&](std::ofstream& file) {
+        uint32_t header[4] = {texture.format, (uint32_t)texture.image.width, (uint32_t)texture.image.height,
+                              (uint32_t)texture.levels.size()};
+        file.write(textureCacheMagic, sizeof(textureCacheMagic));
+        file.write((const char*)header, sizeof(header));
+        for (const auto& level : texture.levels) {
+            file.write((const char*)level.data(), level.size());
+        }
+    });
+}
+
+// Width and height from the header of a PNG or TGA, without decoding it
+bool readImageSize(const std::string& path, const AssetData& asset, int& width, int& height) {
+    const unsigned char* p = (const unsigned char*)asset.data;
+    if (asset.size >= 24 && memcmp(p + 1, "PNG", 3) == 0 && memcmp(p + 12, "IHDR", 4) == 0) {
+        width = (p[16] << 24) | (p[17] << 16) | (p[18] << 8) | p[19];
+        height = (p[20] << 24) | (p[21] << 16) | (p[22] << 8) | p[23];
+        return true;
+    }
+    if (asset.size >= 18 && endsWith(toLower(path), ".tga")) {
+        width = p[12] | (p[13] << 8);
+        height = p[14] | (p[15] << 8);
+        return true;
+    }
+    return false;
+}
+
+// Bilinear resample, used to bring virtual textures to power-of-two sizes
+void resizeImage(Image& image, int width, int height) {
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    for (int y = 0; y < height; y++) {
+        float fy = std::max((y + 0.5f) * image.height / height - 0.5f, 0.0f);
+        int y0 = std::min((int)fy, image.height - 1), y1 = std::min(y0 + 1, image.height - 1);
+        float ty = fy - y0;
+        for (int x = 0; x < width; x++) {
+            float fx = std::max((x + 0.5f) * image.width / width - 0.5f, 0.0f);
+            int x0 = std::min((int)fx, image.width - 1), x1 = std::min(x0 + 1, image.width - 1);
+            float tx = fx - x0;
+            for (int c = 0; c < 4; c++) {
+                auto at = [&](int sx, int sy) { return (float)image.pixels[((size_t)sy * image.width + sx) * 4 + c]; };
+                float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * tx;
+                float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * tx;
+                pixels[((size_t)y * width + x) * 4 + c] = (unsigned char)(top + (bottom - top) * ty + 0.5f);
+            }
+        }
+    }
+    image.width = width;
+    image.height = height;
+    image.pixels.swap(pixels);
+}
+
+std::string virtualTilePath(uint64_t sourceHash) {
+    std::string dir = cacheDirectory();
+    if (dir.empty()) return "";
+
+    char name[40];
+    snprintf(name, sizeof(name), "vtiles-%016llx.bin", (unsigned long long)sourceHash);
+    return dir + "/" + name;
+}
+
+const char virtualTileMagic[8] = {'O', 'B', 'J', 'V', 'T', 'X', '1', '\0'};
+
+// Page counts and first page index of every level of a power-of-two virtual texture
+void layoutVirtualTexture(VirtualTexture& texture) {
+    texture.levels = 1;
+    while ((std::max(texture.width, texture.height) >> (texture.levels - 1)) > 1) texture.levels++;
+
+    int tiles = 0;
+    for (int level = 0; level < texture.levels; level++) {
+        texture.pagesX.push_back(std::max((texture.width >> level) / virtualPageSize, 1));
+        texture.pagesY.push_back(std::max((texture.height >> level) / virtualPageSize, 1));
+        texture.firstTile.push_back(tiles);
+        tiles += texture.pagesX.back() * texture.pagesY.back();
+    }
+    texture.tiles.assign(tiles, -1);
+    texture.pending.assign(tiles, false);
+}
+
+// Cuts the mip chain of an image into bordered, deflated pages and writes the tile file.
+// The image is resized to power-of-two sides (at most 32768) so that every page of a
+// level covers exactly four pages of the level below.
+bool buildVirtualTiles(Image image, const std::string& path) {
+    auto powerOfTwo = [](int size) {
+        int result = 1;
+        while (result * 2 <= std::min(size, 32768)) result *= 2;
+        return (size - result > result * 2 - size && result < 32768) ? result * 2 : result;
+    };
+    int width = powerOfTwo(image.width), height = powerOfTwo(image.height);
+    if (width != image.width || height != image.height) resizeImage(image, width, height);
+
+    VirtualTexture texture;
+    texture.width = width;
+    texture.height = height;
+    layoutVirtualTexture(texture);
+
+    const int side = virtualPageSize + 2 * virtualPageBorder;
+    std::vector<std::vector<unsigned char>> tiles;
+    std::vector<unsigned char> tile((size_t)side * side * 4);
+    for (int level = 0; level < texture.levels; level++) {
+        if (level > 0) halveImage(image);
+        for (int py = 0; py < texture.pagesY[level]; py++) {
+            for (int px = 0; px < texture.pagesX[level]; px++) {
+                // Borders (and pages larger than a small level) wrap like GL_REPEAT
+                for (int y = 0; y < side; y++) {
+                    int sy = ((py * virtualPageSize + y - virtualPageBorder) % image.height + image.height) % image.height;
+                    for (int x = 0; x < side; x++) {
+                        int sx = ((px * virtualPageSize + x - virtualPageBorder) % image.width + image.width) % image.width;
+                        memcpy(&tile[((size_t)y * side + x) * 4], &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+                    }
+                }
+                uLongf size = compressBound(tile.size());
+                std::vector<unsigned char> packed(size);
+                compress2(packed.data(), &size, tile.data(), tile.size(), 1);
+                packed.resize(size);
+                tiles.push_back(std::move(packed));
+            }
+        }
+    }
+
+    return replaceFileAtomically(path, [&](std::ofstream& file) {
+        uint32_t header[3] = {(uint32_t)width, (uint32_t)height, (uint32_t)tiles.size()};
+        file.write(virtualTileMagic, sizeof(virtualTileMagic));
+        file.write((const char*)header, sizeof(header));
+        uint64_t offset = sizeof(virtualTileMagic) + sizeof(header) + (tiles.size() + 1) * sizeof(uint64_t);
+        for (const auto& packed : tiles) {
+            file.write((const char*)&offset, sizeof(offset));
+            offset += packed.size();
+        }
+        file.write((const char*)&offset, sizeof(offset));
+        for (const auto& packed : tiles) {
+            file.write((const char*)packed.data(), packed.size());
+        }
+    });
+}
+
+// Reads the header and page offsets of a tile file. Sides must be the powers of two
+// buildVirtualTiles writes, and the pages must follow the offset table in order up to the
+// end of the file; a damaged file fails and is rebuilt.
+bool openVirtualTexture(const std::string& path, VirtualTexture& texture) {
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(path, ec);
+    std::ifstream file(path, std::ios::binary);
+    if (ec || !file.is_open()) return false;
+
+    char magic[8];
+    uint32_t header[3];
+    file.read(magic, sizeof(magic));
+    file.read((char*)header, sizeof(header));
+    if (!file || memcmp(magic, virtualTileMagic, sizeof(magic)) != 0) return false;
+    auto validSide = [](uint32_t side) { return side > 0 && side <= 32768 && (side & (side - 1)) == 0; };
+    if (!validSide(header[0]) || !validSide(header[1])) return false;
+
+    texture.path = path;
+    texture.width = (int)header[0];
+    texture.height = (int)header[1];
+    layoutVirtualTexture(texture);
+    if (texture.tiles.size() != header[2]) return false;
+    texture.tileOffsets.resize(header[2] + 1);
+    file.read((char*)texture.tileOffsets.data(), texture.tileOffsets.size() * sizeof(uint64_t));
+    if (!file) return false;
+
+    uint64_t dataStart = sizeof(magic) + sizeof(header) + texture.tileOffsets.size() * sizeof(uint64_t);
+    if (texture.tileOffsets.front() != dataStart || texture.tileOffsets.back() != fileSize) return false;
+    for (size_t i = 0; i + 1 < texture.tileOffsets.size(); i++) {
+        if (texture.tileOffsets[i] >= texture.tileOffsets[i + 1]) return false;
+    }
+    return true;
+}
+
+// Loader thread: reads and inflates requested pages until the cache is stopped
+void virtualTileLoader() {
+    const size_t tileBytes = (size_t)(virtualPageSize + 2 * virtualPageBorder) * (virtualPageSize + 2 * virtualPageBorder) * 4;
+    while (true) {
+        std::pair<int, int> request;
+        {
+            std::unique_lock<std::mutex> lock(virtualCache.mutex);
+            virtualCache.changed.wait(lock, []() { return virtualCache.stopping || !virtualCache.requests.empty(); });
+            if (virtualCache.stopping) return;
+            request = virtualCache.requests.front();
+            virtualCache.requests.pop_front();
+        }
+
+        const VirtualTexture& texture = virtualTextures[request.first];
+        uint64_t begin = texture.tileOffsets[request.second], end = texture.tileOffsets[request.second + 1];
+        std::vector<unsigned char> packed(end - begin);
+        std::ifstream file(texture.path, std::ios::binary);
+        file.seekg(begin);
+        file.read((char*)packed.data(), packed.size());
+
+        VirtualTile tile;
+        tile.texture = request.first;
+        tile.tile = request.second;
+        tile.pixels.resize(tileBytes);
+        uLongf size = tileBytes;
+        if (!file || uncompress(tile.pixels.data(), &size, packed.data(), packed.size()) != Z_OK || size != tileBytes) {
+            std::cerr << "Corrupt virtual texture page " << request.second << " in " << texture.path << std::endl;
+            tile.pixels.clear();
+        }
+
+        std::lock_guard<std::mutex> lock(virtualCache.mutex);
+        virtualCache.results.push_back(std::move(tile));
+    }
+}
+
+// Queues a page for loading unless it is resident or already queued
+void requestVirtualTile(int index, int tile) {
+    VirtualTexture& texture = virtualTextures[index];
+    if (texture.tiles[tile] >= 0 || texture.pending[tile]) return;
+    texture.pending[tile] = true;
+    std::lock_guard<std::mutex> lock(virtualCache.mutex);
+    virtualCache.requests.push_back(std::make_pair(index, tile));
+    virtualCache.changed.notify_one();
+}
+
+// Creates the tile cache, page tables and feedback program, starts the loader threads and
+// queues the single-page coarsest level of every virtual texture, which stays resident
+bool startVirtualTextures() {
+    const int side = virtualCacheTiles * (virtualPageSize + 2 * virtualPageBorder);
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    virtualCache.program = compileShaders(vertexShaderSource, virtualFeedbackFragmentShaderSource);
+    if (side > maxSize || virtualCache.program == 0) {
+        std::cerr << "Virtual texturing unavailable, drawing virtual textures in the material color" << std::endl;
+        return false;
+    }
+
+    glGenTextures(1, &virtualCache.texture);
+    glBindTexture(GL_TEXTURE_2D, virtualCache.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, side, side, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    const int slots = virtualCacheTiles * virtualCacheTiles;
+    virtualCache.slotTexture.assign(slots, -1);
+    virtualCache.slotTile.assign(slots, -1);
+    virtualCache.slotUsed.assign(slots, 0);
+
+    for (size_t v = 0; v < virtualTextures.size(); v++) {
+        VirtualTexture& texture = virtualTextures[v];
+        int rows = 0;
+        for (int level = 0; level < texture.levels; level++) rows += texture.pagesY[level];
+        glGenTextures(1, &texture.pageTable);
+        glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, texture.pagesX[0], rows, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        texture.dirty = true;
+        requestVirtualTile((int)v, texture.firstTile[texture.levels - 1]);
+    }
+
+    glGenTextures(1, &virtualCache.feedbackTarget);
+    glGenRenderbuffers(1, &virtualCache.feedbackDepth);
+    glGenFramebuffers(1, &virtualCache.feedbackFBO);
+    glGenBuffers(1, &virtualCache.feedbackPBO);
+
+    glUseProgram(virtualCache.program);
+    glUniform1f(glGetUniformLocation(virtualCache.program, "lodBias"), -std::log2((float)virtualFeedbackScale));
+
+    unsigned int threads = std::max(2u, std::min(4u, std::thread::hardware_concurrency()));
+    for (unsigned int i = 0; i < threads; i++) {
+        virtualCache.loaders.emplace_back(virtualTileLoader);
+    }
+    return true;
+}
+
+void stopVirtualTextures() {
+    {
+        std::lock_guard<std::mutex> lock(virtualCache.mutex);
+        virtualCache.stopping = true;
+        virtualCache.changed.notify_all();
+    }
+    for (auto& loader : virtualCache.loaders) {
+        loader.join();
+    }
+    for (auto& texture : virtualTextures) {
+        glDeleteTextures(1, &texture.pageTable);
+    }
+    glDeleteTextures(1, &virtualCache.texture);
+    glDeleteTextures(1, &virtualCache.feedbackTarget);
+    glDeleteRenderbuffers(1, &virtualCache.feedbackDepth);
+    glDeleteFramebuffers(1, &virtualCache.feedbackFBO);
+    glDeleteBuffers(1, &virtualCache.feedbackPBO);
+    glDeleteProgram(virtualCache.program);
+}
+
+// Binds the page table and tile cache of a virtual texture for `program`
+void bindVirtualTexture(GLuint program, int index) {
+    const VirtualTexture& texture = virtualTextures[index];
+    GLint rows[16] = {0};
+    for (int level = 1; level < texture.levels; level++) {
+        rows[level] = rows[level - 1] + texture.pagesY[level - 1];
+    }
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, virtualCache.texture);
+    glActiveTexture(GL_TEXTURE3);
+    glUniform2i(glGetUniformLocation(program, "virtualSize"), texture.width, texture.height);
+    glUniform1i(glGetUniformLocation(program, "virtualLevels"), texture.levels);
+    glUniform1iv(glGetUniformLocation(program, "pageRows"), 16, rows);
+}
+
+// Renders the virtual-textured corner ranges (one list per virtual texture) into the small
+// feedback target and starts reading it back into the PBO, to be consumed next frame
+void renderVirtualFeedback(const std::vector<MeshBatch>& batches,
+                           const std::vector<std::vector<std::pair<size_t, size_t>>>& ranges,
+                           const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                           int width, int height) {
+    if (virtualCache.feedbackPending) return;
+
+    int feedbackWidth = std::max(width / virtualFeedbackScale, 1);
+    int feedbackHeight = std::max(height / virtualFeedbackScale, 1);
+    glBindFramebuffer(GL_FRAMEBUFFER, virtualCache.feedbackFBO);
+    if (feedbackWidth != virtualCache.feedbackWidth || feedbackHeight != virtualCache.feedbackHeight) {
+        virtualCache.feedbackWidth = feedbackWidth;
+        virtualCache.feedbackHeight = feedbackHeight;
+        glBindTexture(GL_TEXTURE_2D, virtualCache.feedbackTarget);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, feedbackWidth, feedbackHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindRenderbuffer(GL_RENDERBUFFER, virtualCache.feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, virtualCache.feedbackTarget, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, virtualCache.feedbackDepth);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, virtualCache.feedbackPBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)feedbackWidth * feedbackHeight * 8, NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Occlusion by geometry without virtual textures is ignored; those pages load too
+    const GLuint clear[4] = {0, 0, 0, 0};
+    glViewport(0, 0, feedbackWidth, feedbackHeight);
+    glClearBufferuiv(GL_COLOR, 0, clear);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glUseProgram(virtualCache.program);
+    setSceneUniforms(virtualCache.program, model, view, projection, false);
+    for (size_t v = 0; v < ranges.size(); v++) {
+        if (ranges[v].empty()) continue;
+        glUniform1i(glGetUniformLocation(virtualCache.program, "virtualId"), (GLint)v);
+        glUniform2i(glGetUniformLocation(virtualCache.program, "virtualSize"), virtualTextures[v].width, virtualTextures[v].height);
+        glUniform1i(glGetUniformLocation(virtualCache.program, "virtualLevels"), virtualTextures[v].levels);
+        drawMeshRanges(virtualCache.program, batches, ranges[v]);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, virtualCache.feedbackPBO);
+    glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    virtualCache.feedbackPending = true;
+}
+
+// Per frame: turns last frame's feedback into page requests (coarse pages first, resident
+// ones and their ancestors marked as used), moves loaded pages into free or least recently
+// used cache slots, and rewrites the page tables that changed
+void updateVirtualTextures(uint64_t frame) {
+    if (virtualCache.feedbackPending) {
+        virtualCache.feedbackPending = false;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, virtualCache.feedbackPBO);
+        const uint16_t* feedback = (const uint16_t*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        std::vector<uint64_t> needed;
+        if (feedback != NULL) {
+            size_t pixels = (size_t)virtualCache.feedbackWidth * virtualCache.feedbackHeight;
+            for (size_t i = 0; i < pixels; i++) {
+                const uint16_t* p = feedback + 4 * i;
+                if (p[0] == 0 || p[0] > virtualTextures.size()) continue;
+                // Coarse levels sort first so every region gets a fallback quickly
+                needed.push_back((uint64_t)(15 - std::min<uint16_t>(p[1], 15)) << 56 | (uint64_t)(p[0] - 1) << 40 |
+                                 (uint64_t)p[2] << 20 | p[3]);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::sort(needed.begin(), needed.end());
+        needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+
+        for (uint64_t key : needed) {
+            int index = (int)((key >> 40) & 0xFFFF);
+            int level = 15 - (int)(key >> 56);
+            int px = (int)((key >> 20) & 0xFFFFF), py = (int)(key & 0xFFFFF);
+            VirtualTexture& texture = virtualTextures[index];
+            if (level >= texture.levels) continue;
+            for (; level < texture.levels; level++, px /= 2, py /= 2) {
+                if (px >= texture.pagesX[level] || py >= texture.pagesY[level]) break;
+                int tile = texture.firstTile[level] + py * texture.pagesX[level] + px;
+                if (texture.tiles[tile] >= 0) {
+                    virtualCache.slotUsed[texture.tiles[tile]] = std::max(virtualCache.slotUsed[texture.tiles[tile]], frame);
+                } else {
+                    requestVirtualTile(index, tile);
+                }
+            }
+        }
+    }
+
+    std::vector<VirtualTile> loaded;
+    {
+        std::lock_guard<std::mutex> lock(virtualCache.mutex);
+        while (!virtualCache.results.empty() && (int)loaded.size() < virtualUploadsPerFrame) {
+            loaded.push_back(std::move(virtualCache.results.front()));
+            virtualCache.results.pop_front();
+        }
+    }
+
+    const int side = virtualPageSize + 2 * virtualPageBorder;
+    glBindTexture(GL_TEXTURE_2D, virtualCache.texture);
+    for (auto& tile : loaded) {
+        VirtualTexture& texture = virtualTextures[tile.texture];
+        texture.pending[tile.tile] = false;
+        if (tile.pixels.empty()) continue;
+
+        // Free slot, else the least recently used one not needed in the last feedback
+        int slot = -1;
+        for (int s = 0; s < (int)virtualCache.slotUsed.size(); s++) {
+            if (virtualCache.slotTexture[s] < 0) {
+                slot = s;
+                break;
+            }
+            bool stale = virtualCache.slotUsed[s] != UINT64_MAX &&
+                         virtualCache.slotUsed[s] + 2 * virtualFeedbackInterval < frame;
+            if (stale && (slot < 0 || virtualCache.slotUsed[s] < virtualCache.slotUsed[slot])) {
+                slot = s;
+            }
+        }
+        if (slot < 0) continue;
+        if (virtualCache.slotTexture[slot] >= 0) {
+            VirtualTexture& evicted = virtualTextures[virtualCache.slotTexture[slot]];
+            evicted.tiles[virtualCache.slotTile[slot]] = -1;
+            evicted.dirty = true;
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % virtualCacheTiles) * side, (slot / virtualCacheTiles) * side,
+                        side, side, GL_RGBA, GL_UNSIGNED_BYTE, tile.pixels.data());
+        virtualCache.slotTexture[slot] = tile.texture;
+        virtualCache.slotTile[slot] = tile.tile;
+        bool coarsest = tile.tile == texture.firstTile[texture.levels - 1];
+        virtualCache.slotUsed[slot] = coarsest ? UINT64_MAX : frame;
+        texture.tiles[tile.tile] = slot;
+        texture.dirty = true;
+    }
+
+    // Pages that aren't resident point at their nearest resident ancestor
+    std::vector<unsigned char> table;
+    for (auto& texture : virtualTextures) {
+        if (!texture.dirty || texture.pageTable == 0) continue;
+        texture.dirty = false;
+
+        int width = texture.pagesX[0];
+        std::vector<int> rows(texture.levels, 0);
+        for (int level = 1; level < texture.levels; level++) rows[level] = rows[level - 1] + texture.pagesY[level - 1];
+        table.assign((size_t)width * (rows.back() + texture.pagesY.back()) * 4, 0);
+        for (int level = texture.levels - 1; level >= 0; level--) {
+            for (int py = 0; py < texture.pagesY[level]; py++) {
+                for (int px = 0; px < texture.pagesX[level]; px++) {
+                    unsigned char* entry = &table[((size_t)(rows[level] + py) * width + px) * 4];
+                    int slot = texture.tiles[texture.firstTile[level] + py * texture.pagesX[level] + px];
+                    if (slot >= 0) {
+                        entry[0] = (unsigned char)(slot % virtualCacheTiles);
+                        entry[1] = (unsigned char)(slot / virtualCacheTiles);
+                        entry[2] = (unsigned char)level;
+                        entry[3] = 1;
+                    } else if (level + 1 < texture.levels) {
+                        int parentX = std::min(px / 2, texture.pagesX[level + 1] - 1);
+                        int parentY = std::min(py / 2, texture.pagesY[level + 1] - 1);
+                        memcpy(entry, &table[((size_t)(rows[level + 1] + parentY) * width + parentX) * 4], 4);
+                    }
+                }
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, (int)(table.size() / 4 / width), GL_RGBA_INTEGER,
+                        GL_UNSIGNED_BYTE, table.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+}
+
+// Depth texture and framebuffer of the shadow map, compared in hardware when sampled
+bool createShadowMap() {
+    glGenTextures(1, &shadow.depth);
+    glBindTexture(GL_TEXTURE_2D, shadow.depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, shadowMapSize, shadowMapSize, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &shadow.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow.depth, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+// Binds the shadow map for rendering the model's bounding sphere (model space) from the
+// light: an orthographic view along `direction`, with slope-scaled depth bias and both
+// sides drawn so open scans cast shadows too
+void beginShadowMap(const glm::vec3& direction, const glm::vec3& center, float radius) {
+    radius = std::max(radius, 1e-6f);
+    glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    shadow.view = glm::lookAt(center + direction * (2.0f * radius), center, up);
+    shadow.projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+    shadow.direction = direction;
+    shadow.valid = true;
+
+    // Never sampled while it is the render target
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.fbo);
+    glViewport(0, 0, shadowMapSize, shadowMapSize);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+}
+
+void endShadowMap(int width, int height) {
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+// Binds the shadow map and maps world positions through the inverse model transform into it
+void setShadowUniforms(GLuint program, const glm::mat4& model) {
+    glUniform1i(glGetUniformLocation(program, "shadowed"), shadow.valid);
+    if (!shadow.valid) return;
+
+    glm::mat4 toTexture = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+    glm::mat4 shadowMatrix = toTexture * shadow.projection * shadow.view * glm::inverse(model);
+    glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrix"), 1, GL_FALSE, glm::value_ptr(shadowMatrix));
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, shadow.depth);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Matcap of the default lighting: the Blinn-Phong terms of a white sphere seen from the
+// camera, diffuse (with ambient) gamma-encoded in rgb and specular in alpha
+GLuint createMatcapTexture() {
+    glm::vec3 light = glm::normalize(glm::vec3(glm::lookAt(cameraPos, glm::vec3(0.0f), cameraUp) * glm::vec4(lightDir, 0.0f)));
+    glm::vec3 halfway = glm::normalize(light + glm::vec3(0.0f, 0.0f, 1.0f));
+    std::vector<float> pixels((size_t)matcapSize * matcapSize * 4);
+    for (int y = 0; y < matcapSize; y++) {
+        for (int x = 0; x < matcapSize; x++) {
+            // Texel centers beyond the rim take the normal of the nearest rim point
+            glm::vec2 p((x + 0.5f) / matcapSize * 2.0f - 1.0f, (y + 0.5f) / matcapSize * 2.0f - 1.0f);
+            if (glm::length(p) > 1.0f) p = glm::normalize(p);
+            glm::vec3 n(p.x, p.y, std::sqrt(std::max(0.0f, 1.0f - glm::dot(p, p))));
+            float diffuse = 0.3f + std::max(glm::dot(n, light), 0.0f);
+            float specular = 0.5f * std::pow(std::max(glm::dot(n, halfway), 0.0f), 64.0f);
+            float* pixel = &pixels[((size_t)y * matcapSize + x) * 4];
+            pixel[0] = pixel[1] = pixel[2] = std::pow(diffuse, 1.0f / 2.2f);
+            pixel[3] = specular;
+        }
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, matcapSize, matcapSize, 0, GL_RGBA, GL_FLOAT, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Projects a sky environment onto the first 9 spherical harmonics: a gradient from the
+// ground to the zenith plus a sun towards `lightDir`, integrated over a latitude-longitude
+// grid. The coefficients are scaled so that the irradiance formula yields diffuse light.
+void computeEnvironmentSH() {
+    const int rows = 64, columns = 128;
+    const float pi = glm::pi<float>();
+    const float sunCos = std::cos(glm::radians(10.0f));
+    const float sunRadiance = 0.8f * pi / (2.0f * pi * (1.0f - sunCos));
+    for (auto& coefficient : shCoefficients) {
+        coefficient = glm::vec3(0.0f);
+    }
+
+    for (int row = 0; row < rows; row++) {
+        float theta = (row + 0.5f) / rows * pi;
+        float solidAngle = std::sin(theta) * (pi / rows) * (2.0f * pi / columns);
+        for (int column = 0; column < columns; column++) {
+            float phi = (column + 0.5f) / columns * 2.0f * pi;
+            glm::vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+
+            glm::vec3 radiance = d.y > 0.0f ? glm::mix(glm::vec3(0.34f, 0.33f, 0.32f), glm::vec3(0.26f, 0.29f, 0.36f), d.y)
+                                            : glm::vec3(0.18f, 0.17f, 0.16f);
+            if (glm::dot(d, lightDir) > sunCos) {
+                radiance += glm::vec3(sunRadiance);
+            }
+
+            const float basis[9] = {
+                0.282095f,
+                0.488603f * d.y, 0.488603f * d.z, 0.488603f * d.x,
+                1.092548f * d.x * d.y, 1.092548f * d.y * d.z, 0.315392f * (3.0f * d.z * d.z - 1.0f),
+                1.092548f * d.x * d.z, 0.546274f * (d.x * d.x - d.y * d.y),
+            };
+            for (int i = 0; i < 9; i++) {
+                shCoefficients[i] += radiance * (basis[i] * solidAngle / pi);
+            }
+        }
+    }
+}
+
+// Binds the transparency targets (created or resized to the window), clears them and sets
+// up accumulation: color and weights add up, alpha multiplies the revealed background.
+// The depth of the opaque image is copied in; returns false if that isn't possible and the
+// caller must lay the opaque depth down itself.
+bool beginTransparency(int width, int height) {
+    if (transparency.fbo == 0) {
+        glGenFramebuffers(1, &transparency.fbo);
+        glGenTextures(1, &transparency.accumulation);
+        glGenTextures(1, &transparency.weights);
+        glGenRenderbuffers(1, &transparency.depth);
+        glGenVertexArrays(1, &transparency.resolveVAO);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, transparency.fbo);
+    if (width != transparency.width || height != transparency.height) {
+        transparency.width = width;
+        transparency.height = height;
+        glBindTexture(GL_TEXTURE_2D, transparency.accumulation);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, transparency.weights);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, transparency.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, transparency.accumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, transparency.weights, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, transparency.depth);
+        const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+    }
+
+    const GLfloat clearAccumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const GLfloat clearWeights[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+    glClearBufferfv(GL_COLOR, 1, clearWeights);
+
+    // The window's multisampled depth resolves into ours if the formats match
+    if (transparency.copyDepth) {
+        while (glGetError() != GL_NO_ERROR) {}
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, transparency.fbo);
+        if (glGetError() != GL_NO_ERROR) {
+            std::cout << "Can't copy the depth buffer, drawing opaque depth for transparency" << std::endl;
+            transparency.copyDepth = false;
+        }
+    }
+    if (!transparency.copyDepth) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    return transparency.copyDepth;
+}
+
+// Composites the accumulated transparent surfaces over the window and restores the opaque
+// render state
+void resolveTransparency(int width, int height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    glUseProgram(transparency.resolveProgram);
+    glUniform1i(glGetUniformLocation(transparency.resolveProgram, "accumulation"), 0);
+    glUniform1i(glGetUniformLocation(transparency.resolveProgram, "weights"), 1);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, transparency.weights);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, transparency.accumulation);
+    glBindVertexArray(transparency.resolveVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_CULL_FACE);
+}
+
+void destroyTransparency() {
+    glDeleteFramebuffers(1, &transparency.fbo);
+    glDeleteTextures(1, &transparency.accumulation);
+    glDeleteTextures(1, &transparency.weights);
+    glDeleteRenderbuffers(1, &transparency.depth);
+    glDeleteVertexArrays(1, &transparency.resolveVAO);
+    glDeleteProgram(transparency.resolveProgram);
+}
+
+// Draws the triangle ids of `ranges` around pixel (x, y) into the pick target and starts
+// reading them back. The projection is narrowed to the region, so only the objects and
+// section clusters reaching into it are submitted. Skipped while the last readback is
+// still in flight.
+bool renderPickIds(const std::vector<MeshBatch>& batches, const std::vector<std::pair<size_t, size_t>>& ranges,
+                   const std::vector<SceneObject>& objects, const glm::mat4& model, const glm::mat4& view,
+                   const glm::mat4& projection, int width, int height, int x, int y) {
+    if (picking.fence != 0) return false;
+
+    if (picking.fbo == 0) {
+        glGenFramebuffers(1, &picking.fbo);
+        glGenRenderbuffers(1, &picking.ids);
+        glGenRenderbuffers(1, &picking.depth);
+        glBindFramebuffer(GL_FRAMEBUFFER, picking.fbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, picking.ids);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, pickRegion, pickRegion);
+        glBindRenderbuffer(GL_RENDERBUFFER, picking.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, pickRegion, pickRegion);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, picking.ids);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, picking.depth);
+        glGenBuffers(1, &picking.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, picking.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, pickRegion * pickRegion * sizeof(GLuint), NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Scale and shift clip space so that the region's pixels fill the whole target
+    const int left = x - pickRegion / 2, bottom = y - pickRegion / 2;
+    glm::vec2 regionCenter = glm::vec2((left + pickRegion * 0.5f) / width, (bottom + pickRegion * 0.5f) / height) * 2.0f - 1.0f;
+    glm::mat4 pickMatrix = glm::scale(glm::mat4(1.0f), glm::vec3((float)width / pickRegion, (float)height / pickRegion, 1.0f)) *
+                           glm::translate(glm::mat4(1.0f), glm::vec3(-regionCenter, 0.0f));
+    glm::mat4 pickProjection = pickMatrix * projection;
+    picking.validLeft = std::max(-left, 0);
+    picking.validBottom = std::max(-bottom, 0);
+    picking.validRight = std::min(width - left, pickRegion);
+    picking.validTop = std::min(height - bottom, pickRegion);
+
+    selectFrustumRanges(pickProjection * view * model, objects, picking.frustumRanges);
+    intersectRanges(ranges, picking.frustumRanges, picking.passRanges);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, picking.fbo);
+    glViewport(0, 0, pickRegion, pickRegion);
+    const GLuint clear[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, clear);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glUseProgram(picking.program);
+    setSceneUniforms(picking.program, model, view, pickProjection, false);
+    drawMeshRanges(picking.program, batches, picking.passRanges);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, picking.pbo);
+    glReadPixels(0, 0, pickRegion, pickRegion, GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    picking.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (showWireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    }
+    return true;
+}
+
+// The id under the cursor from the last pick pass once it has reached the pixel buffer, or
+// the nearest id in the region when the cursor pixel shows the background (0 if none)
+bool readPickResult(uint32_t& id) {
+    if (picking.fence == 0 || glClientWaitSync(picking.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(picking.fence);
+    picking.fence = 0;
+
+    id = 0;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, picking.pbo);
+    const GLuint* ids = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pickRegion * pickRegion * sizeof(GLuint),
+                                                        GL_MAP_READ_BIT);
+    if (ids != NULL) {
+        const int cursor = pickRegion / 2;
+        int best = INT_MAX;
+        for (int y = picking.validBottom; y < picking.validTop; y++) {
+            for (int x = picking.validLeft; x < picking.validRight; x++) {
+                int distance = (x - cursor) * (x - cursor) + (y - cursor) * (y - cursor);
+                GLuint value = ids[y * pickRegion + x];
+                if (value != 0 && distance < best) {
+                    best = distance;
+                    id = value;
+                }
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void destroyPicking() {
+    if (picking.fence != 0) {
+        glDeleteSync(picking.fence);
+    }
+    glDeleteFramebuffers(1, &picking.fbo);
+    glDeleteRenderbuffers(1, &picking.ids);
+    glDeleteRenderbuffers(1, &picking.depth);
+    glDeleteBuffers(1, &picking.pbo);
+    glDeleteProgram(picking.program);
+}
+
+// Sets up drawing the mesh for the current debug view and returns the program to draw it
+// with: into the count target, cleared, with additive blending for the counting views, or
+// straight into the window for the colored ones
+GLuint beginDebugView(const char* vertexSource, int width, int height, const glm::mat4& model,
+                      const glm::mat4& view, const glm::mat4& projection, size_t triangleCount) {
+    const DebugViewMode& mode = debugViewModes[debugViewMode];
+    if (debugView.program == 0) {
+        debugView.program = compileShaders(vertexSource,
+                                           shaderPermutation(debugViewFragmentShaderSource, heatMapShaderSource).c_str());
+        setSceneSamplerUnits(debugView.program);
+        debugView.resolveProgram = compileShaders(transparencyResolveVertexShaderSource,
+                                                  shaderPermutation(debugViewResolveFragmentShaderSource, heatMapShaderSource).c_str());
+        glGenVertexArrays(1, &debugView.resolveVAO);
+    }
+
+    if (mode.countFragments) {
+        if (debugView.fbo == 0) {
+            glGenFramebuffers(1, &debugView.fbo);
+            glGenTextures(1, &debugView.counts);
+            glGenRenderbuffers(1, &debugView.depth);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, debugView.fbo);
+        if (width != debugView.width || height != debugView.height) {
+            debugView.width = width;
+            debugView.height = height;
+            glBindTexture(GL_TEXTURE_2D, debugView.counts);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glBindRenderbuffer(GL_RENDERBUFFER, debugView.depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, debugView.counts, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, debugView.depth);
+        }
+        const GLfloat clearCounts[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, clearCounts);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+    if (!mode.depthTest) {
+        glDisable(GL_DEPTH_TEST);
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    glUseProgram(debugView.program);
+    setSceneUniforms(debugView.program, model, view, projection, false);
+    glUniform1i(glGetUniformLocation(debugView.program, "debugMode"), debugViewMode);
+    glUniform1ui(glGetUniformLocation(debugView.program, "batchFirstTriangle"), 0);
+    glUniform1f(glGetUniformLocation(debugView.program, "triangleCount"), (float)std::max(triangleCount, (size_t)1));
+    return debugView.program;
+}
+
+// Resolves the fragment counts to a heat map over the window and restores the opaque
+// render state
+void endDebugView(int width, int height) {
+    const DebugViewMode& mode = debugViewModes[debugViewMode];
+    if (mode.countFragments) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(debugView.resolveProgram);
+        glUniform1i(glGetUniformLocation(debugView.resolveProgram, "counts"), 0);
+        glUniform1f(glGetUniformLocation(debugView.resolveProgram, "maxCount"), debugViewMaxCount);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, debugView.counts);
+        glBindVertexArray(debugView.resolveVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glEnable(GL_DEPTH_TEST);
+}
+
+void destroyDebugView() {
+    glDeleteFramebuffers(1, &debugView.fbo);
+    glDeleteTextures(1, &debugView.counts);
+    glDeleteRenderbuffers(1, &debugView.depth);
+    glDeleteVertexArrays(1, &debugView.resolveVAO);
+    glDeleteProgram(debugView.program);
+    glDeleteProgram(debugView.resolveProgram);
+}
+
+// Reads the materials of an MTL library: name, diffuse color and diffuse texture
+void parseMaterialLibrary(const std::string& baseDir, const std::string& library) {
+    const AssetData* mtl = findAsset(baseDir, library);
+    if (mtl == NULL) return;
+    std::string mtlDir = parentPath(resolveAssetPath(baseDir, library));
+
+    std::istringstream file(std::string(mtl->data, mtl->size));
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix, token, last;
+        iss >> prefix;
+        if (prefix == "newmtl") {
+            Material material;
+            material.name = objRecordName(line, prefix);
+            materials.push_back(material);
+        } else if (materials.empty()) {
+            continue;
+        } else if (prefix == "Kd") {
+            glm::vec3& diffuse = materials.back().diffuse;
+            iss >> diffuse.x >> diffuse.y >> diffuse.z;
+        } else if (prefix == "d" || prefix == "Tr") {
+            float value = 1.0f;
+            if (iss >> value) {
+                materials.back().opacity = glm::clamp(prefix == "d" ? value : 1.0f - value, 0.0f, 1.0f);
+            }
+        } else if (prefix == "map_Kd") {
+            // Options come first; the file name is the last token
+            while (iss >> token) last = token;
+            materials.back().diffuseMap = resolveAssetPath(mtlDir, last);
+        }
+    }
+}
+
+// Parses the model's MTL libraries and decodes their diffuse textures in parallel; each
+// distinct texture file becomes one entry of `materialTextures`. Textures found in the
+// compressed cache are read from there instead of being decoded.
+void loadMaterials() {
+    for (const auto& library : materialLibraries) {
+        parseMaterialLibrary(assetBaseDir, library);
+    }
+
+    std::map<std::string, int> textureIds;
+    for (auto& material : materials) {
+        if (material.diffuseMap.empty()) continue;
+        auto inserted = textureIds.emplace(material.diffuseMap, (int)materialTextures.size());
+        if (inserted.second) {
+            MaterialTexture texture;
+            texture.path = material.diffuseMap;
+            materialTextures.push_back(texture);
+        }
+        material.texture = inserted.first->second;
+    }
+
+    std::vector<std::future<void>> decodes;
+    for (auto& texture : materialTextures) {
+        decodes.push_back(std::async(std::launch::async, [&texture]() {
+            const AssetData* asset = findAsset("", texture.path);
+            if (asset == NULL) return;
+            texture.sourceHash = hashBytes(asset->data, asset->size);
+
+            // Oversized textures are cut into a tile file once and paged in while drawing
+            int width = 0, height = 0;
+            std::string tilePath = virtualTilePath(texture.sourceHash);
+            if (virtualTexturePixels > 0 && !tilePath.empty() && readImageSize(texture.path, *asset, width, height) &&
+                std::max(width, height) > virtualTexturePixels) {
+                std::lock_guard<std::mutex> lock(virtualBuildMutex);
+                VirtualTexture existing;
+                if (!openVirtualTexture(tilePath, existing)) {
+                    Image image;
+                    if (!decodeImage(texture.path, *asset, image)) return;
+                    std::error_code ec;
+                    std::cout << (std::filesystem::exists(tilePath, ec) ? "Rebuilding damaged" : "Building")
+                              << " virtual texture tiles for " << texture.path << std::endl;
+                    if (!buildVirtualTiles(std::move(image), tilePath)) return;
+                }
+                texture.virtualPath = tilePath;
+                return;
+            }
+
+            if (compressTextures && readTextureCache(textureCachePath(texture.sourceHash), texture)) return;
+            decodeImage(texture.path, *asset, texture.image);
+        }));
+    }
+    for (auto& decode : decodes) {
+        decode.get();
+    }
+
+    for (auto& texture : materialTextures) {
+        VirtualTexture virtualTexture;
+        if (!texture.virtualPath.empty() && openVirtualTexture(texture.virtualPath, virtualTexture)) {
+            texture.virtualTexture = (int)virtualTextures.size();
+            virtualTextures.push_back(virtualTexture);
+        }
+    }
+
+    // Materials whose texture failed fall back to their diffuse color
+    for (auto& material : materials) {
+        const MaterialTexture* texture = material.texture >= 0 ? &materialTextures[material.texture] : NULL;
+        if (texture != NULL && texture->image.pixels.empty() && texture->levels.empty() && texture->virtualTexture < 0) {
+            material.texture = -1;
+        }
+    }
+}
+
+// Uploads the textures into 2D texture arrays, one per distinct size and format (split at
+// the layer limit), so every material can be drawn with a handful of array binds; virtual
+// textures are numbered after the arrays. Where
+// S3TC is supported, decoded textures are first transcoded to BC1/BC3 on worker threads
+// and written to the compressed cache. Materials without a texture get a 1x1 layer of
+// their diffuse color in a shared array. Texture data is freed; returns the arrays.
+std::vector<GLuint> createMaterialArrays() {
+    GLint maxSize = 0, maxLayers = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // Textures that failed to load have nothing to upload; their materials use `Kd`
+    auto failed = [](const MaterialTexture& texture) {
+        return texture.virtualTexture < 0 && texture.image.pixels.empty() && texture.levels.empty();
+    };
+
+    bool compress = textureCompressionSupported();
+    std::vector<std::future<void>> jobs;
+    for (auto& texture : materialTextures) {
+        if (texture.virtualTexture >= 0 || failed(texture)) continue;
+        if (compress && texture.levels.empty()) {
+            jobs.push_back(std::async(std::launch::async, [&texture, maxSize]() {
+                while (texture.image.width > maxSize || texture.image.height > maxSize) halveImage(texture.image);
+                compressTexture(texture);
+                writeTextureCache(textureCachePath(texture.sourceHash), texture);
+            }));
+        } else if (!compress && !texture.levels.empty()) {
+            // Cached compressed textures this driver can't sample are decoded after all
+            jobs.push_back(std::async(std::launch::async, [&texture]() {
+                texture.format = 0;
+                texture.levels.clear();
+                const AssetData* asset = findAsset("", texture.path);
+                if (asset == NULL || !decodeImage(texture.path, *asset, texture.image)) {
+                    texture.image.width = texture.image.height = 1;
+                    texture.image.pixels.assign(4, 255);
+                }
+            }));
+        }
+    }
+    for (auto& job : jobs) {
+        job.get();
+    }
+
+    for (auto& material : materials) {
+        if (material.texture >= 0) continue;
+        MaterialTexture solid;
+        solid.path = "Kd of " + material.name;
+        solid.image.width = solid.image.height = 1;
+        for (int c = 0; c < 3; c++) {
+            solid.image.pixels.push_back((unsigned char)(glm::clamp(material.diffuse[c], 0.0f, 1.0f) * 255.0f + 0.5f));
+        }
+        solid.image.pixels.push_back(255);
+        solid.solid = true;
+        material.texture = (int)materialTextures.size();
+        materialTextures.push_back(solid);
+    }
+
+    // Group by format and size; color textures are sRGB, solid colors linear like `materialColor`
+    std::map<std::tuple<GLenum, int, int>, std::vector<int>> groups;
+    for (size_t t = 0; t < materialTextures.size(); t++) {
+        MaterialTexture& texture = materialTextures[t];
+        Image& image = texture.image;
+        if (texture.virtualTexture >= 0 || failed(texture)) continue;
+        while (image.width > maxSize || image.height > maxSize) {
+            // Compressed chains drop their top level, decoded images are filtered down
+            if (texture.format != 0) {
+                texture.levels.erase(texture.levels.begin());
+                image.width = std::max(image.width / 2, 1);
+                image.height = std::max(image.height / 2, 1);
+            } else {
+                halveImage(image);
+            }
+        }
+        GLenum format = texture.format != 0 ? texture.format : texture.solid ? GL_RGBA8 : GL_SRGB8_ALPHA8;
+        groups[std::make_tuple(format, image.width, image.height)].push_back((int)t);
+    }
+
+    std::vector<GLuint> arrays;
+    size_t textureBytes = 0;
+    for (const auto& group : groups) {
+        const std::vector<int>& members = group.second;
+        const GLenum format = std::get<0>(group.first);
+        const bool compressed = format != GL_RGBA8 && format != GL_SRGB8_ALPHA8;
+        for (size_t first = 0; first < members.size(); first += maxLayers) {
+            int layers = (int)std::min<size_t>(maxLayers, members.size() - first);
+            int width = std::get<1>(group.first), height = std::get<2>(group.first);
+
+            GLuint array = 0;
+            glGenTextures(1, &array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (compressed) {
+                // Every level of every layer comes from the compressed chains
+                int levels = (int)materialTextures[members[first]].levels.size();
+                for (int level = 0; level < levels; level++) {
+                    int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+                    size_t levelSize = compressedLevelSize(format, levelWidth, levelHeight);
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelWidth, levelHeight, layers, 0,
+                                           (GLsizei)(levelSize * layers), NULL);
+                    for (int layer = 0; layer < layers; layer++) {
+                        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1,
+                                                  format, (GLsizei)levelSize,
+                                                  materialTextures[members[first + layer]].levels[level].data());
+                    }
+                    textureBytes += levelSize * layers;
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            } else {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                for (int layer = 0; layer < layers; layer++) {
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                    materialTextures[members[first + layer]].image.pixels.data());
+                }
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                textureBytes += (size_t)width * height * layers * 4 * 4 / 3;
+            }
+            for (int layer = 0; layer < layers; layer++) {
+                MaterialTexture& texture = materialTextures[members[first + layer]];
+                texture.array = (int)arrays.size();
+                texture.layer = layer;
+                std::vector<unsigned char>().swap(texture.image.pixels);
+                std::vector<std::vector<unsigned char>>().swap(texture.levels);
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            arrays.push_back(array);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Virtual textures are drawn as groups of their own after the arrays
+    for (auto& texture : materialTextures) {
+        if (texture.virtualTexture < 0) continue;
+        texture.array = (int)(arrays.size() + texture.virtualTexture);
+        texture.layer = 0;
+    }
+    std::cout << "Material textures: " << (textureBytes >> 20) << " MB" << (compress ? " (BC1/BC3)" : "") << std::endl;
+    return arrays;
+}
+
+// Per-corner texture coordinates with the material's array layer in z and opacity in w, for
+// every array the corner ranges drawn with it (the last list holds corners without a
+// material), and the ranges of translucent materials
+void buildMaterialCorners(const std::vector<glm::vec2>& uvs, size_t cornerCount, size_t arrayCount,
+                          std::vector<glm::vec4>& texCoords,
+                          std::vector<std::vector<std::pair<size_t, size_t>>>& arrayRanges,
+                          std::vector<std::pair<size_t, size_t>>& transparentRanges) {
+    std::map<std::string, int> materialIds;
+    for (size_t m = 0; m < materials.size(); m++) {
+        materialIds.emplace(materials[m].name, (int)m);
+    }
+
+    texCoords.assign(cornerCount, glm::vec4(0.0f, 0.0f, -1.0f, 1.0f));
+    arrayRanges.assign(arrayCount + 1, std::vector<std::pair<size_t, size_t>>());
+    transparentRanges.clear();
+    size_t cursor = 0;
+    auto addRange = [&](size_t array, size_t first, size_t count) {
+        auto& ranges = arrayRanges[array];
+        if (count == 0) return;
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == first) {
+            ranges.back().second += count;
+        } else {
+            ranges.push_back(std::make_pair(first, count));
+        }
+    };
+    for (const auto& range : materialRanges) {
+        auto it = materialIds.find(range.name);
+        if (it == materialIds.end()) continue;
+        const Material& material = materials[it->second];
+        const MaterialTexture& texture = materialTextures[material.texture];
+
+        addRange(arrayCount, cursor, range.first - cursor);
+        addRange(texture.array, range.first, range.count);
+        cursor = range.first + range.count;
+        if (material.opacity < 1.0f) {
+            transparentRanges.push_back(std::make_pair(range.first, range.count));
+        }
+        for (size_t i = range.first; i < range.first + range.count; i++) {
+            // OBJ texture coordinates start at the bottom, image rows at the top
+            glm::vec2 uv = i < uvs.size() ? uvs[i] : glm::vec2(0.0f);
+            texCoords[i] = glm::vec4(uv.x, 1.0f - uv.y, (float)texture.layer, material.opacity);
+        }
+    }
+    addRange(arrayCount, cursor, cornerCount - cursor);
+}
+
+// Loads the first OBJ inside a zip bundle. Stored entries are parsed straight from the mapping;
+// deflated ones are inflated on a worker thread and parsed chunk by chunk as they arrive.
+// Referenced MTL libraries and their textures are read on worker threads during the parse.
+bool loadOBJBundle(const char* path, 
+                   std::vector<glm::vec3>& out_vertices, 
+                   std::vector<glm::vec3>& out_normals, 
+                   std::vector<glm::vec2>& out_uvs) {
+    if (!openZipArchive(path, bundleArchive)) {
+        return false;
+    }
+
+    const ZipEntry* objEntry = NULL;
+    for (const auto& entry : bundleArchive.entries) {
+        if (endsWith(toLower(entry.name), ".obj") && entry.name.rfind("__MACOSX/", 0) != 0) {
+            objEntry = &entry;
+            break;
+        }
+    }
+    if (objEntry == NULL) {
+        std::cerr << "No OBJ file in bundle: " << path << std::endl;
+        return false;
+    }
+    if (objEntry->flags & 1) {
+        std::cerr << "Encrypted zip entries are not supported: " << objEntry->name << std::endl;
+        return false;
+    }
+    std::cout << "Loading " << objEntry->name << " from bundle" << std::endl;
+    assetBaseDir = parentPath(objEntry->name);
+
+    OBJParseState state;
+    std::vector<std::future<void>> prefetches;
+    auto prefetchNewLibraries = [&]() {
+        while (prefetches.size() < state.materialLibraries.size()) {
+            prefetches.push_back(std::async(std::launch::async, prefetchMaterialLibrary,
+                                            assetBaseDir, state.materialLibraries[prefetches.size()]));
+        }
+    };
+
+    bool ok = true;
+    if (objEntry->method == 0) {
+        const char* data = zipEntryData(bundleArchive, *objEntry);
+        if (data == NULL || objEntry->size != objEntry->compressedSize) {
+            std::cerr << "Corrupt zip entry: " << objEntry->name << std::endl;
+            return false;
+        }
+        parseOBJLines(data, (size_t)objEntry->size, 0, true, state, NULL);
+        prefetchNewLibraries();
+    } else if (objEntry->method == 8) {
+        // Bounded queue between the inflating worker and the parser
+        std::deque<std::vector<char>> chunks;
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool done = false;
+        bool cancelled = false;     // the parser gave up, the inflater stops at its next chunk
+
+        std::thread inflater([&]() {
+            bool inflated = inflateZipEntry(bundleArchive, *objEntry, [&](const char* data, size_t size) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return chunks.size() < 4 || cancelled; });
+                if (cancelled) return false;
+                chunks.emplace_back(data, data + size);
+                changed.notify_all();
+                return true;
+            });
+            std::lock_guard<std::mutex> lock(mutex);
+            ok = inflated;
+            done = true;
+            changed.notify_all();
+        });
+
+        std::vector<char> pending;
+        uint64_t offset = 0;
+        try {
+            while (true) {
+                std::vector<char> chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return !chunks.empty() || done; });
+                    if (chunks.empty()) break;
+                    chunk = std::move(chunks.front());
+                    chunks.pop_front();
+                    changed.notify_all();
+                }
+
+                // Prepend the unfinished line from the previous chunk
+                pending.insert(pending.end(), chunk.begin(), chunk.end());
+                size_t consumed = parseOBJLines(pending.data(), pending.size(), offset, false, state, NULL);
+                pending.erase(pending.begin(), pending.begin() + consumed);
+                offset += consumed;
+                prefetchNewLibraries();
+            }
+        } catch (...) {
+            // A joinable thread must not be destroyed while the exception unwinds
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cancelled = true;
+                changed.notify_all();
+            }
+            inflater.join();
+            throw;
+        }
+        inflater.join();
+        parseOBJLines(pending.data(), pending.size(), offset, true, state, NULL);
+        prefetchNewLibraries();
+
+        if (!ok) {
+            std::cerr << "Failed to inflate zip entry: " << objEntry->name << std::endl;
+        }
+    } else {
+        std::cerr << "Unsupported zip compression method " << objEntry->method << ": " << objEntry->name << std::endl;
+        return false;
+    }
+
+    for (auto& prefetch : prefetches) {
+        prefetch.get();
+    }
+    if (!prefetches.empty()) {
+        std::cout << "Read " << assetCache.size() << " material and texture files from bundle" << std::endl;
+    }
+
+    buildOBJOutput(state, out_vertices, out_normals, out_uvs, patchVertices, patchNormals);
+    return ok;
+}
+
+// Loads only the `o`/`g` blocks named `name`, using the sidecar index to parse just their
+// byte ranges and the runs of v/vt/vn records their faces reference
+bool loadOBJObject(const char* path, const std::string& name,
+                   std::vector<glm::vec3>& out_vertices, 
+                   std::vector<glm::vec3>& out_normals, 
+                   std::vector<glm::vec2>& out_uvs) {
+    OBJIndex index;
+    if (!readOBJIndex(path, index)) {
+        // Build the index with a full parse, then continue with the partial load from memory
+        std::cout << "No up-to-date index for " << path << ", building it with a full parse" << std::endl;
+        index = OBJIndex();
+        if (!buildOBJIndex(path, index)) {
+            return false;
+        }
+        if (index.blocks.empty()) {
+            std::cerr << "File has no objects or groups: " << path << std::endl;
+            return false;
+        }
+    }
+
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        std::cerr << "Cannot open file: " << path << std::endl;
+        unmapFile(file);
+        return false;
+    }
+    auto stale = [&]() {
+        std::cerr << "OBJ index does not match " << path << ", delete " << objIndexPath(path) << std::endl;
+        unmapFile(file);
+        return false;
+    };
+
+    // Faces of the selected blocks. Each block resolves relative indices against the counts
+    // where it starts and begins with the material active there, which may have been set by
+    // a `usemtl` in an earlier block.
+    OBJParseState state;
+    bool found = false;
+    for (const auto& block : index.blocks) {
+        if (block.objectName != name && block.groupName != name) continue;
+        if (block.begin > block.end || block.end > file.size) return stale();
+
+        found = true;
+        if (!block.material.empty() || !state.materialStarts.empty()) {
+            state.materialStarts.push_back(std::make_pair(block.material, state.vertexIndices.size()));
+        }
+        state.vertexBase = block.vertexPrefix;
+        state.uvBase = block.uvPrefix;
+        state.normalBase = block.normalPrefix;
+        state.temp_vertices.clear();
+        state.temp_uvs.clear();
+        state.temp_normals.clear();
+        parseOBJLines(file.data + block.begin, (size_t)(block.end - block.begin), block.begin, true, state, NULL);
+    }
+    if (!found) {
+        std::cerr << "No object or group named '" << name << "' in " << path << std::endl;
+        unmapFile(file);
+        return false;
+    }
+
+    // Mark the runs holding a referenced record; runs of each kind are in file order
+    std::vector<size_t> kindRuns[3];
+    for (size_t r = 0; r < index.runs.size(); r++) {
+        kindRuns[index.runs[r].kind].push_back(r);
+    }
+    std::vector<unsigned int>* references[3][2] = {
+        {&state.vertexIndices, &state.patchVertexIndices},
+        {&state.uvIndices, &state.patchUVIndices},
+        {&state.normalIndices, &state.patchNormalIndices}};
+    auto findRun = [&](int kind, size_t reference) {
+        auto next = std::upper_bound(kindRuns[kind].begin(), kindRuns[kind].end(), reference, [&](size_t value, size_t r) {
+            return value <= index.runs[r].first;
+        });
+        if (next == kindRuns[kind].begin()) return SIZE_MAX;
+        const OBJIndexRun& run = index.runs[*std::prev(next)];
+        return reference <= run.first + run.count ? *std::prev(next) : SIZE_MAX;
+    };
+    std::vector<size_t> packedFirst(index.runs.size(), SIZE_MAX);
+    for (int kind = 0; kind < 3; kind++) {
+        for (auto* list : references[kind]) {
+            for (unsigned int reference : *list) {
+                size_t r = reference > 0 ? findRun(kind, reference) : SIZE_MAX;
+                if (r != SIZE_MAX) packedFirst[r] = 0;
+            }
+        }
+    }
+
+    // Parse just those runs, packing their records in file order
+    OBJParseState records;
+    auto recordCount = [&](int kind) {
+        return kind == 0 ? records.temp_vertices.size() : kind == 1 ? records.temp_uvs.size() : records.temp_normals.size();
+    };
+    size_t parsedRuns = 0;
+    for (size_t r = 0; r < index.runs.size(); r++) {
+        if (packedFirst[r] == SIZE_MAX) continue;
+        const OBJIndexRun& run = index.runs[r];
+        if (run.begin > run.end || run.end > file.size) return stale();
+        packedFirst[r] = recordCount(run.kind);
+        parseOBJLines(file.data + run.begin, (size_t)(run.end - run.begin), run.begin, true, records, NULL);
+        if (recordCount(run.kind) != packedFirst[r] + run.count) return stale();
+        parsedRuns++;
+    }
+    unmapFile(file);
+    std::cout << "Parsed " << parsedRuns << " of " << index.runs.size() << " vertex data runs" << std::endl;
+
+    // Point the faces at the packed records; references outside every run stay unresolved
+    for (int kind = 0; kind < 3; kind++) {
+        for (auto* list : references[kind]) {
+            for (unsigned int& reference : *list) {
+                size_t r = reference > 0 ? findRun(kind, reference) : SIZE_MAX;
+                reference = r == SIZE_MAX ? 0 : (unsigned int)(packedFirst[r] + reference - index.runs[r].first);
+            }
+        }
+    }
+    state.temp_vertices.swap(records.temp_vertices);
+    state.temp_uvs.swap(records.temp_uvs);
+    state.temp_normals.swap(records.temp_normals);
+    state.vertexBase = state.uvBase = state.normalBase = 0;
+
+    // `mtllib` normally sits in the file header, which a partial load skips
+    state.materialLibraries = index.materialLibraries;
+
+    buildOBJOutput(state, out_vertices, out_normals, out_uvs, patchVertices, patchNormals);
+    return true;
+}
+
+void calculateSmoothNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals) {
+    // Map to store vertex position to vertex indices
+    std::map<VertexKey, std::vector<size_t>> vertexMap;
+    
+    // First, identify identical vertices
+    for (size_t i = 0; i < vertices.size(); i++) {
+        VertexKey key = {vertices[i]};
+        vertexMap[key].push_back(i);
+    }
+    
+    // Calculate face normals first
+    for (size_t i = 0; i < vertices.size(); i += 3) {
+        if (i + 2 < vertices.size()) {
+            glm::vec3 v0 = vertices[i];
+            glm::vec3 v1 = vertices[i + 1];
+            glm::vec3 v2 = vertices[i + 2];
+            
+            // Calculate face normal
+            glm::vec3 edge1 = v1 - v0;
+            glm::vec3 edge2 = v2 - v0;
+            glm::vec3 faceNormal = glm::cross(edge1, edge2);
+            
+            // Accumulate this normal for each vertex of the triangle
+            normals[i] += faceNormal;
+            normals[i + 1] += faceNormal;
+            normals[i + 2] += faceNormal;
+        }
+    }
+    
+    // Now, average normals for identical vertices
+    for (const auto& entry : vertexMap) {
+        if (entry.second.size() > 1) {
+            // Accumulate all normals
+            glm::vec3 avgNormal(0.0f);
+            for (size_t idx : entry.second) {
+                avgNormal += normals[idx];
+            }
+            
+            // Normalize and assign back
+            avgNormal = glm::normalize(avgNormal);
+            for (size_t idx : entry.second) {
+                normals[idx] = avgNormal;
+            }
+        } else if (entry.second.size() == 1) {
+            // Just normalize single normals
+            size_t idx = entry.second[0];
+            normals[idx] = glm::normalize(normals[idx]);
+        }
+    }
+}
+
+// Splits `vertexCount` corners into whole-triangle batches of at most `maxBytes` of vertex
+// data and `maxCorners` corners
+std::vector<MeshBatch> planMeshBatches(size_t vertexCount, size_t maxBytes, size_t maxCorners) {
+    const size_t bytesPerCorner = (normalStream ? 2 : 1) * sizeof(glm::vec3);
+    size_t cornersPerBatch = std::max<size_t>(maxBytes / bytesPerCorner / 3, 1) * 3;
+    cornersPerBatch = std::min<size_t>(cornersPerBatch, std::min<size_t>(maxCorners, INT32_MAX) / 3 * 3);
+
+    std::vector<MeshBatch> batches;
+    for (size_t first = 0; first < vertexCount || batches.empty(); first += cornersPerBatch) {
+        MeshBatch batch;
+        batch.first = first;
+        batch.count = (GLsizei)std::min(cornersPerBatch, vertexCount - first);
+        batches.push_back(batch);
+    }
+    return batches;
+}
+
+void uploadMeshBatch(MeshBatch& batch, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals,
+                     const std::vector<glm::vec4>& texCoords, const std::vector<uint32_t>& weldIds) {
+    if (batch.count == 0) {
+        // All geometry is in quad patches
+        return;
+    }
+    if (vertexPulling) {
+        uploadPulledBatch(batch, vertices, normals);
+        return;
+    }
+
+    glGenVertexArrays(1, &batch.VAO);
+    glGenBuffers(1, &batch.VBO);
+    if (!normals.empty() || !weldIds.empty()) {
+        glGenBuffers(1, &batch.NBO);
+    }
+
+    glBindVertexArray(batch.VAO);
+
+    // Position attribute
+    glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+    glBufferData(GL_ARRAY_BUFFER, batch.count * sizeof(glm::vec3), vertices.data() + batch.first, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Normal attribute
+    if (!normals.empty()) {
+        glBindBuffer(GL_ARRAY_BUFFER, batch.NBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.count * sizeof(glm::vec3), normals.data() + batch.first, GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(1);
+    } else if (!weldIds.empty()) {
+        // Filled in by computeNormalsGPU() once every batch is uploaded
+        glBindBuffer(GL_ARRAY_BUFFER, batch.NBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.count * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(1);
+
+        glGenBuffers(1, &batch.WBO);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.WBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.count * sizeof(uint32_t), weldIds.data() + batch.first, GL_STATIC_DRAW);
+    }
+
+    // Texture coordinate, material layer and opacity attribute
+    if (!texCoords.empty()) {
+        glGenBuffers(1, &batch.TBO);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.TBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.count * sizeof(glm::vec4), texCoords.data() + batch.first, GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(2);
+    }
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "Out of GPU memory uploading corners " << batch.first << " to "
+                  << batch.first + batch.count << std::endl;
+        return;
+    }
+    batch.uploaded = true;
+}
+
+// Creates a buffer texture viewing `buffer` with the given texel format
+GLuint createBufferTexture(GLuint buffer, GLenum format) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return texture;
+}
+
+// Uploads a batch for vertex pulling: corners are deduplicated on (position, normal),
+// positions quantized to 16 bits within the batch bounds, normals octahedral-encoded to
+// 16 bits, and the per-corner indices stored as 16 bits when the batch allows it.
+// With smooth normals this is roughly 6 bytes per corner instead of 24.
+void uploadPulledBatch(MeshBatch& batch, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals) {
+    const bool hasNormals = !normals.empty();
+    const size_t end = batch.first + batch.count;
+
+    glm::vec3 minBound = vertices[batch.first], maxBound = vertices[batch.first];
+    for (size_t i = batch.first; i < end; i++) {
+        minBound = glm::min(minBound, vertices[i]);
+        maxBound = glm::max(maxBound, vertices[i]);
+    }
+    batch.origin = minBound;
+    batch.extent = maxBound - minBound;
+    glm::vec3 scale = glm::vec3(
+        batch.extent.x > 0.0f ? 65535.0f / batch.extent.x : 0.0f,
+        batch.extent.y > 0.0f ? 65535.0f / batch.extent.y : 0.0f,
+        batch.extent.z > 0.0f ? 65535.0f / batch.extent.z : 0.0f);
+
+    // Deduplicate on the encoded vertex, so quantization can only merge more corners
+    std::unordered_map<uint64_t, uint32_t> ids;
+    std::vector<uint16_t> positions;
+    std::vector<uint16_t> encodedNormals;
+    std::vector<uint32_t> indices(batch.count);
+    ids.reserve(batch.count / 4);
+
+    for (size_t i = batch.first; i < end; i++) {
+        glm::vec3 q = (vertices[i] - minBound) * scale + glm::vec3(0.5f);
+        uint16_t p[4] = {(uint16_t)q.x, (uint16_t)q.y, (uint16_t)q.z, 0};
+        uint16_t n[2] = {0, 0};
+        if (hasNormals) {
+            glm::vec2 e = encodeOctahedral(normals[i]) * 0.5f + glm::vec2(0.5f);
+            n[0] = (uint16_t)(glm::clamp(e.x, 0.0f, 1.0f) * 65535.0f + 0.5f);
+            n[1] = (uint16_t)(glm::clamp(e.y, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+
+        uint64_t key = hashBytes(n, sizeof(n), hashBytes(p, sizeof(p)));
+        auto inserted = ids.emplace(key, (uint32_t)(positions.size() / 4));
+        uint32_t id = inserted.first->second;
+        if (inserted.second) {
+            positions.insert(positions.end(), p, p + 4);
+            if (hasNormals) encodedNormals.insert(encodedNormals.end(), n, n + 2);
+        } else if (memcmp(&positions[4 * id], p, sizeof(p)) != 0 ||
+                   (hasNormals && memcmp(&encodedNormals[2 * id], n, sizeof(n)) != 0)) {
+            // Hash collision: store the vertex again rather than merging different vertices
+            id = (uint32_t)(positions.size() / 4);
+            positions.insert(positions.end(), p, p + 4);
+            if (hasNormals) encodedNormals.insert(encodedNormals.end(), n, n + 2);
+        }
+        indices[i - batch.first] = id;
+    }
+
+    glGenVertexArrays(1, &batch.VAO);
+    glGenBuffers(1, &batch.IBO);
+    glGenBuffers(1, &batch.VBO);
+
+    const size_t vertexCount = positions.size() / 4;
+    glBindBuffer(GL_TEXTURE_BUFFER, batch.IBO);
+    if (vertexCount <= 65536) {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        glBufferData(GL_TEXTURE_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        batch.textures[0] = createBufferTexture(batch.IBO, GL_R16UI);
+    } else {
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        batch.textures[0] = createBufferTexture(batch.IBO, GL_R32UI);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, batch.VBO);
+    glBufferData(GL_TEXTURE_BUFFER, positions.size() * sizeof(uint16_t), positions.data(), GL_STATIC_DRAW);
+    batch.textures[1] = createBufferTexture(batch.VBO, GL_RGBA16);
+
+    if (hasNormals) {
+        glGenBuffers(1, &batch.NBO);
+        glBindBuffer(GL_TEXTURE_BUFFER, batch.NBO);
+        glBufferData(GL_TEXTURE_BUFFER, encodedNormals.size() * sizeof(uint16_t), encodedNormals.data(), GL_STATIC_DRAW);
+        batch.textures[2] = createBufferTexture(batch.NBO, GL_RG16);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "Out of GPU memory uploading corners " << batch.first << " to " << end << std::endl;
+        return;
+    }
+    batch.uploaded = true;
+}
+
+// Compiles and links one stage; returns 0 and reports the log on failure
+GLuint compileShaderStage(GLenum type, const char* source, const char* label) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::" << label << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Links compiled stages (0 for stages that failed) into a program and deletes the stages;
+// returns 0 and reports the log on failure
+GLuint linkShaderStages(const std::vector<GLuint>& stages) {
+    GLuint program = glCreateProgram();
+    bool compiled = true;
+    for (GLuint stage : stages) {
+        compiled = compiled && stage != 0;
+        if (stage != 0) glAttachShader(program, stage);
+    }
+    if (compiled) {
+        glLinkProgram(program);
+    }
+    for (GLuint stage : stages) {
+        glDeleteShader(stage);
+    }
+
+    int success = 0;
+    if (compiled) {
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+    }
+    if (!success) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint compileTessellationShaders(const char* fragmentSource) {
+    return linkShaderStages({
+        compileShaderStage(GL_VERTEX_SHADER, patchVertexShaderSource, "PATCH_VERTEX"),
+        compileShaderStage(GL_TESS_CONTROL_SHADER, patchControlShaderSource, "TESS_CONTROL"),
+        compileShaderStage(GL_TESS_EVALUATION_SHADER, patchEvaluationShaderSource, "TESS_EVALUATION"),
+        compileShaderStage(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT"),
+    });
+}
+
+GLuint compileSilhouetteShaders() {
+    return linkShaderStages({
+        compileShaderStage(GL_VERTEX_SHADER, silhouetteVertexShaderSource, "SILHOUETTE_VERTEX"),
+        compileShaderStage(GL_GEOMETRY_SHADER, shaderPermutation(silhouetteGeometryShaderSource, octahedralShaderSource).c_str(),
+                           "SILHOUETTE_GEOMETRY"),
+        compileShaderStage(GL_FRAGMENT_SHADER, edgeFragmentShaderSource, "FRAGMENT"),
+    });
+}
+
+// Smooth normals for triangles and patches together: each quad contributes its two triangles
+void calculatePatchNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+                           const std::vector<glm::vec3>& patches, std::vector<glm::vec3>& patchNormals) {
+    const size_t triangleCorners = vertices.size();
+    vertices.reserve(triangleCorners + patches.size() / 4 * 6);
+    for (size_t i = 0; i + 3 < patches.size(); i += 4) {
+        const glm::vec3* quad = &patches[i];
+        vertices.insert(vertices.end(), {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]});
+    }
+
+    normals.assign(vertices.size(), glm::vec3(0.0f));
+    calculateSmoothNormals(vertices, normals);
+
+    // Corners 0, 1, 2 and 3 of each quad are triangle corners 0, 1, 2 and 5
+    patchNormals.resize(patches.size());
+    const size_t corner[4] = {0, 1, 2, 5};
+    for (size_t q = 0; q < patches.size() / 4; q++) {
+        for (size_t k = 0; k < 4; k++) {
+            patchNormals[4 * q + k] = normals[triangleCorners + 6 * q + corner[k]];
+        }
+    }
+
+    vertices.resize(triangleCorners);
+    normals.resize(triangleCorners);
+}
+
+// Fallback without tessellation: moves the patches into the triangle arrays
+void appendPatchesAsTriangles(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals,
+                              std::vector<glm::vec3>& patches, std::vector<glm::vec3>& patchNormals) {
+    const size_t order[6] = {0, 1, 2, 0, 2, 3};
+    for (size_t i = 0; i + 3 < patches.size(); i += 4) {
+        for (size_t k : order) {
+            vertices.push_back(patches[i + k]);
+            if (!patchNormals.empty()) normals.push_back(patchNormals[i + k]);
+        }
+    }
+    std::vector<glm::vec3>().swap(patches);
+    std::vector<glm::vec3>().swap(patchNormals);
+}
+
+// Assigns every corner the id of its position, so corners at identical positions share an id
+void weldPositions(const std::vector<glm::vec3>& vertices, std::vector<uint32_t>& weldIds) {
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> ids;
+    ids.reserve(vertices.size() / 4);
+    weldIds.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto inserted = ids.emplace(VertexKey{vertices[i]}, (uint32_t)ids.size());
+        weldIds[i] = inserted.first->second;
+    }
+}
+
+bool computeShadersSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+}
+
+GLuint compileComputeShader(const char* source) {
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Dispatches `count` invocations of 256-wide work groups, split to respect the group count limit
+void dispatchCompute1D(GLuint program, const char* firstUniform, size_t count) {
+    const size_t maxPerDispatch = (size_t)65535 * 256;
+    GLint firstLoc = glGetUniformLocation(program, firstUniform);
+    for (size_t first = 0; first < count; first += maxPerDispatch) {
+        size_t n = std::min(maxPerDispatch, count - first);
+        glUniform1ui(firstLoc, (GLuint)first);
+        glDispatchCompute((GLuint)((n + 255) / 256), 1, 1);
+    }
+}
+
+// Accumulates face normals of every batch per weld id, then writes normalized normals into each NBO
+void computeNormalsGPU(std::vector<MeshBatch>& batches, uint32_t weldCount,
+                       GLuint accumulateProgram, GLuint resolveProgram) {
+    GLuint accumulators;
+    glGenBuffers(1, &accumulators);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, accumulators);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)weldCount * 3 * sizeof(GLint), NULL, GL_DYNAMIC_COPY);
+    GLint zero = 0;
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &zero);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, accumulators);
+
+    glUseProgram(accumulateProgram);
+    for (const auto& batch : batches) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch.VBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch.WBO);
+        glUniform1ui(glGetUniformLocation(accumulateProgram, "triangleCount"), batch.count / 3);
+        dispatchCompute1D(accumulateProgram, "firstTriangle", batch.count / 3);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram(resolveProgram);
+    for (auto& batch : batches) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch.WBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, batch.NBO);
+        glUniform1ui(glGetUniformLocation(resolveProgram, "cornerCount"), batch.count);
+        dispatchCompute1D(resolveProgram, "firstCorner", batch.count);
+    }
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    for (auto& batch : batches) {
+        glDeleteBuffers(1, &batch.WBO);
+        batch.WBO = 0;
+    }
+    glDeleteBuffers(1, &accumulators);
+    glUseProgram(0);
+}
+
+// The GPU now owns the geometry; features that read it back (edges, slices) take what they
+// need while loading
+void releaseMeshCopies(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec2>& uvs) {
+    std::vector<glm::vec3>().swap(vertices);
+    std::vector<glm::vec3>().swap(normals);
+    std::vector<glm::vec2>().swap(uvs);
+}
+
+// 30-bit Morton code of a point normalized to [0, 1]^3
+uint32_t mortonCode(glm::vec3 p) {
+    auto spread = [](uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    };
+    p = glm::clamp(p * 1023.0f, 0.0f, 1023.0f);
+    return (spread((uint32_t)p.x) << 2) | (spread((uint32_t)p.y) << 1) | spread((uint32_t)p.z);
+}
+
+// Bounding sphere (xyz center, w radius) of the vertices of some triangles
+glm::vec4 triangleSphere(const std::vector<glm::vec3>& positions, const uint32_t* triangles, size_t count) {
+    glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (size_t i = 0; i < count * 3; i++) {
+        minBound = glm::min(minBound, positions[triangles[i]]);
+        maxBound = glm::max(maxBound, positions[triangles[i]]);
+    }
+    glm::vec3 center = (minBound + maxBound) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i < count * 3; i++) {
+        radius = std::max(radius, glm::length(positions[triangles[i]] - center));
+    }
+    return glm::vec4(center, radius);
+}
+
+// Sphere enclosing other spheres, so errors projected with it never shrink from child to parent
+glm::vec4 enclosingSphere(const std::vector<glm::vec4>& spheres) {
+    glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (const auto& sphere : spheres) {
+        minBound = glm::min(minBound, glm::vec3(sphere) - glm::vec3(sphere.w));
+        maxBound = glm::max(maxBound, glm::vec3(sphere) + glm::vec3(sphere.w));
+    }
+    glm::vec3 center = (minBound + maxBound) * 0.5f;
+    float radius = 0.0f;
+    for (const auto& sphere : spheres) {
+        radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+    }
+    return glm::vec4(center, radius);
+}
+
+// Orders triangles (vertex index triples) so that every run of `lodClusterSize` is a
+// compact patch: seeds are taken along a Morton curve of the centroids and each cluster
+// grows breadth-first over triangles sharing a vertex. `order` receives the source index
+// of every output triangle.
+void orderTrianglesForClusters(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& triangles,
+                               std::vector<uint32_t>* order = nullptr) {
+    const size_t count = triangles.size() / 3;
+    glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (uint32_t v : triangles) {
+        minBound = glm::min(minBound, positions[v]);
+        maxBound = glm::max(maxBound, positions[v]);
+    }
+    glm::vec3 extent = glm::max(maxBound - minBound, glm::vec3(1e-20f));
+
+    std::vector<std::pair<uint32_t, uint32_t>> keys(count);
+    for (size_t t = 0; t < count; t++) {
+        glm::vec3 centroid = (positions[triangles[3 * t]] + positions[triangles[3 * t + 1]] + positions[triangles[3 * t + 2]]) / 3.0f;
+        keys[t] = std::make_pair(mortonCode((centroid - minBound) / extent), (uint32_t)t);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // Triangles around each vertex, as ranges of a flat list indexed by compacted vertex
+    std::unordered_map<uint32_t, uint32_t> local;
+    std::vector<uint32_t> localIds(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        localIds[i] = local.emplace(triangles[i], (uint32_t)local.size()).first->second;
+    }
+    std::vector<uint32_t> offsets(local.size() + 1, 0);
+    for (uint32_t id : localIds) offsets[id + 1]++;
+    for (size_t i = 1; i < offsets.size(); i++) offsets[i] += offsets[i - 1];
+    std::vector<uint32_t> incident(triangles.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangles.size(); i++) incident[fill[localIds[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<uint32_t> sequence;
+    sequence.reserve(count);
+    std::vector<char> taken(count, 0);
+    std::deque<uint32_t> frontier;
+    for (const auto& key : keys) {
+        if (taken[key.second]) continue;
+
+        // Grow one cluster from this seed
+        size_t clusterEnd = sequence.size() + lodClusterSize;
+        frontier.clear();
+        frontier.push_back(key.second);
+        taken[key.second] = 1;
+        while (!frontier.empty() && sequence.size() < clusterEnd) {
+            uint32_t t = frontier.front();
+            frontier.pop_front();
+            sequence.push_back(t);
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t id = localIds[3 * t + k];
+                for (uint32_t i = offsets[id]; i < offsets[id + 1]; i++) {
+                    if (!taken[incident[i]]) {
+                        taken[incident[i]] = 1;
+                        frontier.push_back(incident[i]);
+                    }
+                }
+            }
+        }
+        // Triangles reached but not used go back to the pool for later seeds
+        for (uint32_t t : frontier) taken[t] = 0;
+    }
+
+    std::vector<uint32_t> sorted(triangles.size());
+    for (size_t t = 0; t < count; t++) {
+        for (size_t k = 0; k < 3; k++) {
+            sorted[3 * t + k] = triangles[3 * sequence[t] + k];
+        }
+    }
+    triangles.swap(sorted);
+    if (order) {
+        order->swap(sequence);
+    }
+}
+
+// Partitions clusters into groups of up to 4 that share the most border vertices, so
+// group borders are short and, unlike a fixed spatial split, move between levels: every
+// border locked at one level tends to be interior to a group at the next. Clusters are
+// visited in Morton order of their centers; a group with no unassigned neighbour left is
+// filled with the next unassigned clusters along the curve.
+std::vector<std::vector<uint32_t>> groupLODClusters(const LODMesh& lod, const std::vector<std::vector<uint32_t>>& clusterTriangles,
+                                                    const std::vector<uint32_t>& clusters, size_t vertexCount) {
+    glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (uint32_t c : clusters) {
+        minBound = glm::min(minBound, glm::vec3(lod.clusters[c].cullBounds));
+        maxBound = glm::max(maxBound, glm::vec3(lod.clusters[c].cullBounds));
+    }
+    glm::vec3 extent = glm::max(maxBound - minBound, glm::vec3(1e-20f));
+    std::vector<std::pair<uint32_t, uint32_t>> keys;
+    for (size_t i = 0; i < clusters.size(); i++) {
+        glm::vec3 center = glm::vec3(lod.clusters[clusters[i]].cullBounds);
+        keys.push_back(std::make_pair(mortonCode((center - minBound) / extent), (uint32_t)i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // Count shared vertices between clusters through the first cluster using each vertex
+    std::vector<uint32_t> owner(vertexCount, UINT32_MAX);
+    std::vector<std::unordered_map<uint32_t, uint32_t>> shared(clusters.size());
+    for (size_t i = 0; i < clusters.size(); i++) {
+        for (uint32_t v : clusterTriangles[clusters[i]]) {
+            if (owner[v] == UINT32_MAX) {
+                owner[v] = (uint32_t)i;
+            } else if (owner[v] != i) {
+                shared[i][owner[v]]++;
+                shared[owner[v]][(uint32_t)i]++;
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> groups;
+    std::vector<char> assigned(clusters.size(), 0);
+    size_t cursor = 0;
+    for (const auto& key : keys) {
+        if (assigned[key.second]) continue;
+        std::vector<uint32_t> members(1, key.second);
+        assigned[key.second] = 1;
+        while (members.size() < 4) {
+            std::unordered_map<uint32_t, uint32_t> candidates;
+            for (uint32_t m : members) {
+                for (const auto& entry : shared[m]) {
+                    if (!assigned[entry.first]) candidates[entry.first] += entry.second;
+                }
+            }
+            uint32_t best = UINT32_MAX, bestCount = 0;
+            for (const auto& entry : candidates) {
+                if (entry.second > bestCount || (entry.second == bestCount && entry.first < best)) {
+                    best = entry.first;
+                    bestCount = entry.second;
+                }
+            }
+            if (best == UINT32_MAX) {
+                while (cursor < keys.size() && assigned[keys[cursor].second]) cursor++;
+                if (cursor == keys.size()) break;
+                best = keys[cursor].second;
+            }
+            members.push_back(best);
+            assigned[best] = 1;
+        }
+
+        groups.emplace_back();
+        for (uint32_t m : members) groups.back().push_back(clusters[m]);
+    }
+    return groups;
+}
+
+// Result of simplifying one group: triangles referencing existing vertices, or new ones
+// (ids with the top bit set index `newPositions`)
+struct LODGroupResult {
+    std::vector<uint32_t> triangles;
+    std::vector<glm::vec3> newPositions;
+    std::vector<glm::vec3> newNormals;
+    float error = 0.0f;
+    bool simplified = false;
+};
+
+const uint32_t lodNewVertexBit = 0x80000000u;
+
+// Simplifies a group to about half its triangles by collapsing the shortest edges first.
+// Vertices shared with other groups are locked, so the group's border matches its
+// neighbours whichever level they are drawn at, and so are vertices on edges used by only
+// one of the group's triangles: open borders of the mesh and seams where the normals are
+// split, which would otherwise shrink or crack. Collapses that would flip a triangle are
+// skipped. The error is the furthest any vertex has moved from the surface it came from.
+void simplifyLODGroup(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+                      const std::vector<char>& locked, const std::vector<uint32_t>& triangles,
+                      LODGroupResult& result) {
+    // Local copy of the group's vertices
+    std::unordered_map<uint32_t, uint32_t> localIds;
+    std::vector<uint32_t> globalIds;
+    std::vector<uint32_t> corners(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        auto inserted = localIds.emplace(triangles[i], (uint32_t)globalIds.size());
+        if (inserted.second) globalIds.push_back(triangles[i]);
+        corners[i] = inserted.first->second;
+    }
+    const size_t vertexCount = globalIds.size();
+    std::vector<glm::vec3> position(vertexCount);
+    std::vector<glm::vec3> normal(vertexCount, glm::vec3(0.0f));
+    std::vector<float> error(vertexCount, 0.0f);
+    std::vector<char> moved(vertexCount, 0);
+    std::vector<uint32_t> parent(vertexCount);
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        position[v] = positions[globalIds[v]];
+        if (!normals.empty()) normal[v] = normals[globalIds[v]];
+        parent[v] = (uint32_t)v;
+    }
+    for (size_t i = 0; i < corners.size(); i++) {
+        vertexTriangles[corners[i]].push_back((uint32_t)(i / 3));
+    }
+
+    std::vector<char> pinned(vertexCount, 0);
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t i = 0; i < corners.size(); i++) {
+        uint32_t a = corners[i], b = corners[i / 3 * 3 + (i + 1) % 3];
+        edgeUses[(uint64_t)std::min(a, b) << 32 | std::max(a, b)]++;
+    }
+    for (const auto& edge : edgeUses) {
+        if (edge.second == 1) {
+            pinned[edge.first >> 32] = 1;
+            pinned[edge.first & 0xFFFFFFFFu] = 1;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        pinned[v] |= locked[globalIds[v]];
+    }
+
+    auto find = [&](uint32_t v) {
+        while (parent[v] != v) v = parent[v] = parent[parent[v]];
+        return v;
+    };
+    auto faceNormal = [&](size_t t, uint32_t replaced, glm::vec3 p) {
+        glm::vec3 q[3];
+        for (size_t k = 0; k < 3; k++) q[k] = corners[3 * t + k] == replaced ? p : position[corners[3 * t + k]];
+        return glm::cross(q[1] - q[0], q[2] - q[0]);
+    };
+
+    typedef std::pair<float, std::pair<uint32_t, uint32_t>> Edge;
+    std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge>> edges;
+    for (size_t t = 0; t < corners.size() / 3; t++) {
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t a = corners[3 * t + k], b = corners[3 * t + (k + 1) % 3];
+            edges.push(Edge(glm::length(position[a] - position[b]), std::make_pair(a, b)));
+        }
+    }
+
+    std::vector<char> alive(corners.size() / 3, 1);
+    size_t aliveCount = alive.size();
+    const size_t target = alive.size() / 2;
+    while (aliveCount > target && !edges.empty()) {
+        Edge edge = edges.top();
+        edges.pop();
+        uint32_t a = find(edge.second.first), b = find(edge.second.second);
+        if (a == b || (pinned[a] && pinned[b])) continue;
+        float length = glm::length(position[a] - position[b]);
+        if (length > edge.first) {
+            edges.push(Edge(length, std::make_pair(a, b)));
+            continue;
+        }
+
+        // Keep the locked end in place, otherwise meet in the middle
+        uint32_t keep = pinned[b] ? b : a;
+        uint32_t gone = keep == a ? b : a;
+        glm::vec3 target = pinned[keep] ? position[keep] : (position[a] + position[b]) * 0.5f;
+
+        bool flips = false;
+        for (uint32_t v : {a, b}) {
+            for (uint32_t t : vertexTriangles[v]) {
+                if (!alive[t]) continue;
+                bool hasA = false, hasB = false;
+                for (size_t k = 0; k < 3; k++) {
+                    hasA |= corners[3 * t + k] == a;
+                    hasB |= corners[3 * t + k] == b;
+                }
+                if (hasA && hasB) continue;
+                glm::vec3 before = faceNormal(t, v, position[v]);
+                glm::vec3 after = faceNormal(t, v, target);
+                if (glm::dot(before, after) <= 0.0f) flips = true;
+            }
+        }
+        if (flips) continue;
+
+        error[keep] = std::max(error[a], error[b]) +
+                      std::max(glm::length(position[a] - target), glm::length(position[b] - target));
+        if (!pinned[keep]) {
+            position[keep] = target;
+            float len = glm::length(normal[a] + normal[b]);
+            normal[keep] = len > 0.0f ? (normal[a] + normal[b]) / len : normal[keep];
+            moved[keep] = 1;
+        }
+        parent[gone] = keep;
+
+        for (uint32_t t : vertexTriangles[gone]) {
+            if (!alive[t]) continue;
+            for (size_t k = 0; k < 3; k++) {
+                if (corners[3 * t + k] == gone) corners[3 * t + k] = keep;
+            }
+            if (corners[3 * t] == corners[3 * t + 1] || corners[3 * t + 1] == corners[3 * t + 2] ||
+                corners[3 * t] == corners[3 * t + 2]) {
+                alive[t] = 0;
+                aliveCount--;
+            } else {
+                vertexTriangles[keep].push_back(t);
+            }
+        }
+        std::vector<uint32_t>().swap(vertexTriangles[gone]);
+
+        for (uint32_t t : vertexTriangles[keep]) {
+            if (!alive[t]) continue;
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = corners[3 * t + k];
+                if (v != keep) edges.push(Edge(glm::length(position[keep] - position[v]), std::make_pair(keep, v)));
+            }
+        }
+    }
+
+    // Unmoved vertices keep their ids; moved ones become new vertices of the group
+    std::vector<uint32_t> newIds(vertexCount, UINT32_MAX);
+    result.error = 0.0f;
+    for (size_t t = 0; t < alive.size(); t++) {
+        if (!alive[t]) continue;
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t v = corners[3 * t + k];
+            if (!moved[v]) {
+                result.triangles.push_back(globalIds[v]);
+                continue;
+            }
+            if (newIds[v] == UINT32_MAX) {
+                newIds[v] = (uint32_t)result.newPositions.size();
+                result.newPositions.push_back(position[v]);
+                if (!normals.empty()) result.newNormals.push_back(normal[v]);
+            }
+            result.triangles.push_back(newIds[v] | lodNewVertexBit);
+        }
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        result.error = std::max(result.error, error[v]);
+    }
+    // Groups that barely shrink (mostly locked) are regrouped at the next level
+    result.simplified = result.triangles.size() <= triangles.size() * 85 / 100;
+}
 
-        // Fixed camera position looking at the center
-        glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), cameraUp);
-        
-        // Get window size
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        float aspectRatio = (float)width / (float)height;
+// Appends clusters of `lodClusterSize` triangles to the LOD mesh, expanding them to corners
+void emitLODClusters(LODMesh& lod, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+                     const std::vector<uint32_t>& triangles, uint32_t level, glm::vec4 bounds, float error,
+                     std::vector<std::vector<uint32_t>>& clusterTriangles) {
+    for (size_t first = 0; first < triangles.size(); first += lodClusterSize * 3) {
+        size_t end = std::min(triangles.size(), first + lodClusterSize * 3);
 
-        glm::mat4 projection = glm::perspective(glm::radians(zoom), aspectRatio, 0.1f, 100.0f);
+        LODCluster cluster;
+        cluster.firstCorner = lod.positions.size();
+        cluster.cornerCount = (uint32_t)(end - first);
+        cluster.level = level;
+        cluster.cullBounds = triangleSphere(positions, &triangles[first], (end - first) / 3);
+        cluster.bounds = level == 0 ? cluster.cullBounds : bounds;
+        cluster.error = error;
+        cluster.parentBounds = cluster.bounds;
+        cluster.parentError = FLT_MAX;
+
+        for (size_t i = first; i < end; i++) {
+            lod.positions.push_back(positions[triangles[i]]);
+            if (!normals.empty()) lod.normals.push_back(normals[triangles[i]]);
+        }
+        lod.clusters.push_back(cluster);
+        clusterTriangles.emplace_back(triangles.begin() + first, triangles.begin() + end);
+    }
+}
 
-        // Set matrices
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+// Vertex of the LOD mesh: corners are welded only where both position and normal match
+struct LODVertexKey {
+    uint32_t position;
+    glm::vec3 normal;
 
-        // Draw the model
-        glBindVertexArray(VAO);
-        
-        if (showWireframe) {
-            // Wireframe rendering
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            glLineWidth(1.0f);
+    bool operator==(const LODVertexKey& other) const {
+        return position == other.position && normal == other.normal;
+    }
+};
+
+struct LODVertexKeyHash {
+    size_t operator()(const LODVertexKey& key) const {
+        glm::vec3 normal = key.normal + glm::vec3(0.0f);
+        return (size_t)hashBytes(&normal, sizeof(normal), key.position);
+    }
+};
+
+// Builds the cluster hierarchy: level 0 is the input mesh in spatially sorted clusters; each
+// further level merges groups of up to 4 adjacent clusters, simplifies them to about half the
+// triangles and splits the result into new clusters. Groups of a level are simplified in
+// parallel. Every cluster records its own error and bounds and those of the group that
+// replaced it, which is all the per-frame selection needs.
+void buildLOD(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, LODMesh& lod) {
+    // Index the soup by position and normal, so hard edges of the file stay split
+    std::vector<uint32_t> weldIds;
+    weldPositions(vertices, weldIds);
+    if (!normals.empty()) {
+        std::unordered_map<LODVertexKey, uint32_t, LODVertexKeyHash> ids;
+        ids.reserve(vertices.size() / 4);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            weldIds[i] = ids.emplace(LODVertexKey{weldIds[i], normals[i]}, (uint32_t)ids.size()).first->second;
+        }
+    }
+    uint32_t vertexCount = 0;
+    for (uint32_t id : weldIds) vertexCount = std::max(vertexCount, id + 1);
+
+    std::vector<glm::vec3> positions(vertexCount);
+    std::vector<glm::vec3> vertexNormals(normals.empty() ? 0 : vertexCount);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[weldIds[i]] = vertices[i];
+        if (!normals.empty()) vertexNormals[weldIds[i]] = normals[i];
+    }
+
+    std::vector<uint32_t> triangles(weldIds.begin(), weldIds.begin() + vertices.size() / 3 * 3);
+    std::vector<uint32_t>().swap(weldIds);
+    std::vector<uint32_t> order;
+    orderTrianglesForClusters(positions, triangles, &order);
+
+    std::vector<std::vector<uint32_t>> clusterTriangles;
+    std::vector<uint32_t> current;
+    emitLODClusters(lod, positions, vertexNormals, triangles, 0, glm::vec4(0.0f), 0.0f, clusterTriangles);
+    for (size_t c = 0; c < lod.clusters.size(); c++) current.push_back((uint32_t)c);
+    const size_t level0Corners = lod.positions.size();
+    lod.baseCorners = level0Corners;
+    std::vector<uint32_t>().swap(triangles);
+
+    const unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t level = 1; current.size() > 1 && level < 32; level++) {
+        const std::vector<std::vector<uint32_t>> groups = groupLODClusters(lod, clusterTriangles, current, positions.size());
+        const size_t groupCount = groups.size();
+
+        // Lock vertices referenced by more than one group
+        std::vector<uint32_t> owner(positions.size(), UINT32_MAX);
+        std::vector<char> locked(positions.size(), 0);
+        for (size_t g = 0; g < groupCount; g++) {
+            for (uint32_t c : groups[g]) {
+                for (uint32_t v : clusterTriangles[c]) {
+                    if (owner[v] == UINT32_MAX) owner[v] = (uint32_t)g;
+                    else if (owner[v] != g) locked[v] = 1;
+                }
+            }
+        }
+
+        std::vector<LODGroupResult> results(groupCount);
+        std::atomic<size_t> nextGroup(0);
+        std::vector<std::thread> threads;
+        for (unsigned w = 0; w < workers; w++) {
+            threads.emplace_back([&]() {
+                for (size_t g; (g = nextGroup++) < groupCount;) {
+                    std::vector<uint32_t> groupTriangles;
+                    for (uint32_t c : groups[g]) {
+                        groupTriangles.insert(groupTriangles.end(), clusterTriangles[c].begin(), clusterTriangles[c].end());
+                    }
+                    simplifyLODGroup(positions, vertexNormals, locked, groupTriangles, results[g]);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        // Clusters of groups that did not simplify are carried over to be regrouped with
+        // other neighbours, so their vertices stay locked for the groups around them
+        std::vector<uint32_t> next;
+        bool progress = false;
+        for (size_t g = 0; g < groupCount; g++) {
+            LODGroupResult& result = results[g];
+            if (!result.simplified || result.triangles.empty()) {
+                result.simplified = false;
+                next.insert(next.end(), groups[g].begin(), groups[g].end());
+                continue;
+            }
+            progress = true;
+
+            // Give the group's new vertices global ids
+            const uint32_t base = (uint32_t)positions.size();
+            positions.insert(positions.end(), result.newPositions.begin(), result.newPositions.end());
+            vertexNormals.insert(vertexNormals.end(), result.newNormals.begin(), result.newNormals.end());
+            for (auto& v : result.triangles) {
+                if (v & lodNewVertexBit) v = base + (v & ~lodNewVertexBit);
+            }
+
+            // Errors only grow towards the roots and are projected with enclosing bounds
+            std::vector<glm::vec4> childBounds;
+            float error = result.error;
+            for (uint32_t c : groups[g]) {
+                childBounds.push_back(lod.clusters[c].bounds);
+                error = std::max(error, lod.clusters[c].error);
+            }
+            glm::vec4 bounds = enclosingSphere(childBounds);
+            error = std::nextafter(error, FLT_MAX);
+            for (uint32_t c : groups[g]) {
+                lod.clusters[c].parentBounds = bounds;
+                lod.clusters[c].parentError = error;
+            }
+
+            orderTrianglesForClusters(positions, result.triangles);
+            size_t first = lod.clusters.size();
+            emitLODClusters(lod, positions, vertexNormals, result.triangles, level, bounds, error, clusterTriangles);
+            for (size_t c = first; c < lod.clusters.size(); c++) next.push_back((uint32_t)c);
+            LODGroupResult().triangles.swap(result.triangles);
+        }
+
+        // Source triangles of consumed clusters are no longer needed
+        for (size_t g = 0; g < groupCount; g++) {
+            if (!results[g].simplified) continue;
+            for (uint32_t c : groups[g]) {
+                std::vector<uint32_t>().swap(clusterTriangles[c]);
+            }
+        }
+        current.swap(next);
+        if (!progress) break;
+    }
+
+    // Level 0 clusters draw the original corners rather than welded vertices
+    for (size_t corner = 0; corner < level0Corners; corner++) {
+        size_t source = 3 * (size_t)order[corner / 3] + corner % 3;
+        lod.positions[corner] = vertices[source];
+        if (!normals.empty()) lod.normals[corner] = normals[source];
+    }
+}
+
+// Cache file for the LOD hierarchy of a model, keyed by its path, object and file stamp
+std::string lodCachePath(const char* path, const std::string& objectName) {
+    std::string dir = cacheDirectory();
+    uint64_t size = 0;
+    int64_t time = 0;
+    if (dir.empty() || !objSourceStamp(path, size, time)) return "";
+
+    std::error_code ec;
+    std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+    uint64_t hash = hashString(ec ? std::string(path) : absolute.string());
+    hash = hashString(objectName, hash);
+    hash = hashBytes(&size, sizeof(size), hash);
+    hash = hashBytes(&time, sizeof(time), hash);
+    hash = hashBytes(&normalStream, sizeof(normalStream), hash);
+
+    char name[40];
+    snprintf(name, sizeof(name), "lod-%016llx.bin", (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+// LOD cache layout, little-endian: magic, format version, cluster/position/normal/base
+// counts (u64), then per cluster its first corner (u64), corner count and level (u32) and
+// cull bounds, bounds, error, parent bounds and parent error (f32), then the positions and
+// normals as f32 triples. Bump the version whenever the layout or the builder changes.
+const char lodCacheMagic[8] = {'O', 'B', 'J', 'L', 'O', 'D', '\0', '\0'};
+const uint32_t lodCacheVersion = 2;
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be three packed floats");
+
+bool readLODCache(const std::string& path, LODMesh& lod) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    const uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    char magic[8];
+    uint32_t version = 0;
+    uint64_t counts[4];
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)counts, sizeof(counts));
+    if (!file || memcmp(magic, lodCacheMagic, sizeof(magic)) != 0 || version != lodCacheVersion) return false;
+
+    // The counts must fit the file before anything is allocated for them
+    const uint64_t clusterBytes = 8 + 2 * 4 + 14 * 4;
+    const uint64_t headerBytes = sizeof(magic) + sizeof(version) + sizeof(counts);
+    if (counts[0] == 0 || counts[0] > fileSize / clusterBytes || counts[1] > fileSize / sizeof(glm::vec3) ||
+        (counts[2] != 0 && counts[2] != counts[1]) || counts[3] > counts[1] ||
+        headerBytes + counts[0] * clusterBytes + (counts[1] + counts[2]) * sizeof(glm::vec3) != fileSize) {
+        return false;
+    }
+
+    lod.clusters.resize(counts[0]);
+    for (auto& cluster : lod.clusters) {
+        uint64_t firstCorner = 0;
+        float values[14];
+        file.read((char*)&firstCorner, sizeof(firstCorner));
+        file.read((char*)&cluster.cornerCount, sizeof(cluster.cornerCount));
+        file.read((char*)&cluster.level, sizeof(cluster.level));
+        file.read((char*)values, sizeof(values));
+        cluster.firstCorner = (size_t)firstCorner;
+        cluster.cullBounds = glm::vec4(values[0], values[1], values[2], values[3]);
+        cluster.bounds = glm::vec4(values[4], values[5], values[6], values[7]);
+        cluster.error = values[8];
+        cluster.parentBounds = glm::vec4(values[9], values[10], values[11], values[12]);
+        cluster.parentError = values[13];
+        if (firstCorner > counts[1] || cluster.cornerCount > counts[1] - firstCorner) {
+            file.setstate(std::ios::failbit);
+            break;
+        }
+    }
+    lod.positions.resize(counts[1]);
+    lod.normals.resize(counts[2]);
+    lod.baseCorners = counts[3];
+    file.read((char*)lod.positions.data(), lod.positions.size() * sizeof(glm::vec3));
+    file.read((char*)lod.normals.data(), lod.normals.size() * sizeof(glm::vec3));
+    if (!file) {
+        lod = LODMesh();
+        return false;
+    }
+    return true;
+}
+
+void writeLODCache(const std::string& path, const LODMesh& lod) {
+    replaceFileAtomically(path, [&](std::ofstream& file) {
+        uint64_t counts[4] = {lod.clusters.size(), lod.positions.size(), lod.normals.size(), lod.baseCorners};
+        file.write(lodCacheMagic, sizeof(lodCacheMagic));
+        file.write((const char*)&lodCacheVersion, sizeof(lodCacheVersion));
+        file.write((const char*)counts, sizeof(counts));
+        for (const auto& cluster : lod.clusters) {
+            uint64_t firstCorner = cluster.firstCorner;
+            const float values[14] = {
+                cluster.cullBounds.x, cluster.cullBounds.y, cluster.cullBounds.z, cluster.cullBounds.w,
+                cluster.bounds.x, cluster.bounds.y, cluster.bounds.z, cluster.bounds.w,
+                cluster.error,
+                cluster.parentBounds.x, cluster.parentBounds.y, cluster.parentBounds.z, cluster.parentBounds.w,
+                cluster.parentError};
+            file.write((const char*)&firstCorner, sizeof(firstCorner));
+            file.write((const char*)&cluster.cornerCount, sizeof(cluster.cornerCount));
+            file.write((const char*)&cluster.level, sizeof(cluster.level));
+            file.write((const char*)values, sizeof(values));
+        }
+        file.write((const char*)lod.positions.data(), lod.positions.size() * sizeof(glm::vec3));
+        file.write((const char*)lod.normals.data(), lod.normals.size() * sizeof(glm::vec3));
+    });
+}
+
+// Uploads the corners of all levels into buffers of at most `batchBytes`, never splitting
+// a cluster, then frees the CPU copy; clusters remember which buffer they live in
+void uploadLOD(LODMesh& lod, std::vector<LODBuffer>& buffers) {
+    const size_t bytesPerCorner = sizeof(glm::vec3) * (lod.normals.empty() ? 1 : 2);
+    const size_t maxCorners = std::max<size_t>(batchBytes / bytesPerCorner, lodClusterSize * 3);
+
+    size_t c = 0;
+    while (c < lod.clusters.size()) {
+        LODBuffer buffer;
+        buffer.firstCorner = lod.clusters[c].firstCorner;
+        size_t end = buffer.firstCorner;
+        for (; c < lod.clusters.size() && lod.clusters[c].firstCorner + lod.clusters[c].cornerCount - buffer.firstCorner <= maxCorners; c++) {
+            lod.clusters[c].buffer = (uint32_t)buffers.size();
+            end = lod.clusters[c].firstCorner + lod.clusters[c].cornerCount;
+        }
+
+        glGenVertexArrays(1, &buffer.VAO);
+        glBindVertexArray(buffer.VAO);
+
+        glGenBuffers(1, &buffer.VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+        glBufferData(GL_ARRAY_BUFFER, (end - buffer.firstCorner) * sizeof(glm::vec3),
+                     &lod.positions[buffer.firstCorner], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(0);
+
+        if (!lod.normals.empty()) {
+            glGenBuffers(1, &buffer.NBO);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer.NBO);
+            glBufferData(GL_ARRAY_BUFFER, (end - buffer.firstCorner) * sizeof(glm::vec3),
+                         &lod.normals[buffer.firstCorner], GL_STATIC_DRAW);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+            glEnableVertexAttribArray(1);
+        }
+        buffers.push_back(buffer);
+    }
+
+    std::vector<glm::vec3>().swap(lod.positions);
+    std::vector<glm::vec3>().swap(lod.normals);
+}
+
+// Screen-space size in pixels of a model-space error at the given bounds
+float projectedLODError(const glm::vec4& bounds, float error, const glm::mat4& model, float scale, float pixelsPerRadian) {
+    if (error == FLT_MAX) return FLT_MAX;
+    glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f));
+    float distance = std::max(glm::length(center - cameraPos) - bounds.w * scale, 0.1f);
+    return error * scale / distance * pixelsPerRadian;
+}
+
+// Picks the clusters to draw this frame: a cluster is drawn when its own error is small
+// enough on screen but its parent group's is not. Errors and bounds only grow towards the
+// roots, so exactly one level is chosen for every part of the surface and neighbouring
+// choices meet along locked group borders. Clusters outside the view or wholly removed by
+// the section planes in sectionMask are skipped. Fills per-buffer draw ranges and returns
+// the number of triangles selected.
+size_t selectLODClusters(const LODMesh& lod, const std::vector<LODBuffer>& buffers, const glm::mat4& model,
+                         const glm::mat4& viewProjection, float pixelsPerRadian, float threshold, unsigned int sectionMask,
+                         std::vector<std::vector<GLint>>& firsts, std::vector<std::vector<GLsizei>>& counts) {
+    // Frustum planes of the combined matrix, in world space
+    glm::mat4 m = glm::transpose(viewProjection);
+    glm::vec4 planes[6] = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]};
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    const float scale = glm::length(glm::vec3(model[0]));
+
+    firsts.resize(buffers.size());
+    counts.resize(buffers.size());
+    for (auto& list : firsts) list.clear();
+    for (auto& list : counts) list.clear();
+    size_t triangles = 0;
+    for (const auto& cluster : lod.clusters) {
+        if (projectedLODError(cluster.bounds, cluster.error, model, scale, pixelsPerRadian) > threshold ||
+            projectedLODError(cluster.parentBounds, cluster.parentError, model, scale, pixelsPerRadian) <= threshold) {
+            continue;
+        }
+
+        glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(cluster.cullBounds), 1.0f));
+        float radius = cluster.cullBounds.w * scale;
+        bool visible = true;
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                visible = false;
+                break;
+            }
+        }
+        if (!visible || sectionClipsSphere(glm::vec3(cluster.cullBounds), cluster.cullBounds.w, sectionMask)) continue;
+
+        firsts[cluster.buffer].push_back((GLint)(cluster.firstCorner - buffers[cluster.buffer].firstCorner));
+        counts[cluster.buffer].push_back((GLsizei)cluster.cornerCount);
+        triangles += cluster.cornerCount / 3;
+    }
+    return triangles;
+}
+
+// Octahedral normal encoding: the unit sphere is folded onto a square, two snorm16 values per normal
+glm::vec2 encodeOctahedral(glm::vec3 n) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (!(sum > 0.0f)) return glm::vec2(0.0f);
+    n /= sum;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e = glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+glm::vec3 decodeOctahedral(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(n);
+}
+
+// Sets the lighting, material and transformation uniforms shared by the viewer's programs
+void setSceneUniforms(GLuint program, const glm::mat4& model, const glm::mat4& view,
+                      const glm::mat4& projection, bool flat) {
+    // Set uniform values
+    GLint viewPosLoc = glGetUniformLocation(program, "viewPos");
+    GLint lightDirLoc = glGetUniformLocation(program, "lightDir");
+    GLint materialColorLoc = glGetUniformLocation(program, "materialColor");
+    GLint flatShadingLoc = glGetUniformLocation(program, "flatShading");
+    
+    GLint modelLoc = glGetUniformLocation(program, "model");
+    GLint viewLoc = glGetUniformLocation(program, "view");
+    GLint projectionLoc = glGetUniformLocation(program, "projection");
+
+    glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
+    glUniform3fv(lightDirLoc, 1, glm::value_ptr(lightDir));
+    glUniform3fv(materialColorLoc, 1, glm::value_ptr(materialColor));
+    glUniform1i(flatShadingLoc, flat);
+    glUniform3fv(glGetUniformLocation(program, "shCoefficients"), 9, glm::value_ptr(shCoefficients[0]));
+    glUniform4fv(glGetUniformLocation(program, "sectionPlanes"), maxSectionPlanes, glm::value_ptr(sectionModelPlanes[0]));
+
+    // Set matrices
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+}
+
+// Fixed texture units of the scene programs' samplers: samplers of different types must
+// never share a unit, even when unused
+void setSceneSamplerUnits(GLuint program) {
+    if (program == 0) return;
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "vertexIndices"), 0);
+    glUniform1i(glGetUniformLocation(program, "positions"), 1);
+    glUniform1i(glGetUniformLocation(program, "encodedNormals"), 2);
+    glUniform1i(glGetUniformLocation(program, "materialTextures"), 3);
+    glUniform1i(glGetUniformLocation(program, "pageTable"), 4);
+    glUniform1i(glGetUniformLocation(program, "tileCache"), 5);
+    glUniform1i(glGetUniformLocation(program, "shadowMap"), 6);
+    glUniform1i(glGetUniformLocation(program, "matcap"), 7);
+}
+
+// Bounding spheres of the scene objects, from the corners of each object
+void calculateObjectBounds(const std::vector<glm::vec3>& vertices) {
+    for (auto& object : sceneObjects) {
+        glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+        for (size_t i = object.first; i < object.first + object.count; i++) {
+            minBound = glm::min(minBound, vertices[i]);
+            maxBound = glm::max(maxBound, vertices[i]);
+        }
+        object.center = (minBound + maxBound) * 0.5f;
+        object.radius = 0.0f;
+        for (size_t i = object.first; i < object.first + object.count; i++) {
+            object.radius = std::max(object.radius, glm::length(vertices[i] - object.center));
+        }
+    }
+}
+
+// Intersection of two sorted lists of disjoint corner ranges
+void intersectRanges(const std::vector<std::pair<size_t, size_t>>& a, const std::vector<std::pair<size_t, size_t>>& b,
+                     std::vector<std::pair<size_t, size_t>>& out) {
+    out.clear();
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        size_t begin = std::max(a[i].first, b[j].first);
+        size_t end = std::min(a[i].first + a[i].second, b[j].first + b[j].second);
+        if (begin < end) out.push_back(std::make_pair(begin, end - begin));
+        if (a[i].first + a[i].second < b[j].first + b[j].second) i++;
+        else j++;
+    }
+}
+
+// Draws corner ranges (first, count) of the mesh, sorted by first, from the batches that
+// hold them; adjacent ranges are merged and each batch is drawn with one multi-draw
+void drawMeshRanges(GLuint program, const std::vector<MeshBatch>& batches,
+                    const std::vector<std::pair<size_t, size_t>>& ranges) {
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+    for (const auto& batch : batches) {
+        if (!batch.uploaded) continue;
+
+        firsts.clear();
+        counts.clear();
+        const size_t batchEnd = batch.first + batch.count;
+        for (const auto& range : ranges) {
+            size_t begin = std::max(range.first, batch.first);
+            size_t end = std::min(range.first + range.second, batchEnd);
+            if (begin >= end) continue;
+            if (!firsts.empty() && (size_t)(firsts.back() + counts.back()) == begin - batch.first) {
+                counts.back() += (GLsizei)(end - begin);
+            } else {
+                firsts.push_back((GLint)(begin - batch.first));
+                counts.push_back((GLsizei)(end - begin));
+            }
+        }
+        if (firsts.empty()) continue;
+
+        bindMeshBatch(program, batch);
+        glMultiDrawArrays(GL_TRIANGLES, firsts.data(), counts.data(), (GLsizei)firsts.size());
+    }
+}
+
+// Binds a batch's vertex array, and with vertex pulling its buffer textures and bounds
+void bindMeshBatch(GLuint program, const MeshBatch& batch) {
+    glBindVertexArray(batch.VAO);
+    glUniform1ui(glGetUniformLocation(program, "batchFirstTriangle"), (GLuint)(batch.first / 3));
+    if (vertexPulling) {
+        for (int unit = 0; unit < 3; unit++) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_BUFFER, batch.textures[unit]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform3fv(glGetUniformLocation(program, "positionOrigin"), 1, glm::value_ptr(batch.origin));
+        glUniform3fv(glGetUniformLocation(program, "positionExtent"), 1, glm::value_ptr(batch.extent));
+        glUniform1i(glGetUniformLocation(program, "hasNormals"), batch.NBO != 0);
+    }
+}
+
+// Finds the feature edges and silhouette candidates of the triangle soup in two parallel
+// passes, each thread owning a hash shard: corners are welded by position, then the edges
+// between welded corners are matched up to compare their faces' normals
+void extractEdges(const std::vector<glm::vec3>& vertices) {
+    const size_t triangles = vertices.size() / 3;
+    const unsigned int threadCount = std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+    auto runThreads = [&](const std::function<void(unsigned int)>& work) {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < threadCount; t++) {
+            threads.emplace_back(work, t);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+
+    // Sort item indices by shard in one counting pass, so each thread walks only its own items.
+    // Items whose shard is threadCount are dropped; the order within a shard stays ascending
+    std::vector<uint8_t> shardOf(vertices.size());
+    std::vector<size_t> order, shardStarts(threadCount + 2);
+    auto partition = [&]() {
+        std::fill(shardStarts.begin(), shardStarts.end(), 0);
+        for (uint8_t shard : shardOf) {
+            shardStarts[shard + 1]++;
+        }
+        for (unsigned int t = 0; t <= threadCount; t++) {
+            shardStarts[t + 1] += shardStarts[t];
+        }
+        order.resize(shardStarts[threadCount]);
+        std::vector<size_t> cursors(shardStarts.begin(), shardStarts.end() - 2);
+        for (size_t i = 0; i < shardOf.size(); i++) {
+            if (shardOf[i] < threadCount) order[cursors[shardOf[i]]++] = i;
+        }
+    };
+
+    // Weld: shard-local ids first, then offset by the sizes of the preceding shards
+    std::vector<uint32_t> ids(vertices.size());
+    std::vector<uint32_t> shardOffsets(threadCount + 1, 0);
+    VertexKeyHash positionHash;
+    runThreads([&](unsigned int t) {
+        size_t begin = vertices.size() * t / threadCount, end = vertices.size() * (t + 1) / threadCount;
+        for (size_t i = begin; i < end; i++) {
+            shardOf[i] = (uint8_t)(positionHash(VertexKey{vertices[i]}) % threadCount);
+        }
+    });
+    partition();
+    runThreads([&](unsigned int t) {
+        std::unordered_map<VertexKey, uint32_t, VertexKeyHash> shard;
+        for (size_t k = shardStarts[t]; k < shardStarts[t + 1]; k++) {
+            size_t i = order[k];
+            ids[i] = shard.emplace(VertexKey{vertices[i]}, (uint32_t)shard.size()).first->second;
+        }
+        shardOffsets[t + 1] = (uint32_t)shard.size();
+    });
+    for (unsigned int t = 0; t < threadCount; t++) {
+        shardOffsets[t + 1] += shardOffsets[t];
+    }
+    runThreads([&](unsigned int t) {
+        size_t begin = vertices.size() * t / threadCount, end = vertices.size() * (t + 1) / threadCount;
+        for (size_t i = begin; i < end; i++) {
+            ids[i] += shardOffsets[shardOf[i]];
+        }
+    });
+
+    // Face normals once, zero for degenerate faces
+    std::vector<glm::vec3> faceNormals(triangles);
+    runThreads([&](unsigned int t) {
+        size_t begin = triangles * t / threadCount, end = triangles * (t + 1) / threadCount;
+        for (size_t f = begin; f < end; f++) {
+            const size_t c = 3 * f;
+            glm::vec3 normal = glm::cross(vertices[c + 1] - vertices[c], vertices[c + 2] - vertices[c]);
+            float length = glm::length(normal);
+            faceNormals[f] = length == 0.0f ? glm::vec3(0.0f) : normal / length;
+        }
+    });
+
+    // Corner c stands for the edge from c to the next corner of its face; edges are sharded by key
+    auto edgeKey = [&](size_t c) {
+        uint32_t ia = ids[c], ib = ids[c - c % 3 + (c + 1) % 3];
+        return (uint64_t)std::min(ia, ib) << 32 | std::max(ia, ib);
+    };
+    runThreads([&](unsigned int t) {
+        size_t begin = triangles * 3 * t / threadCount, end = triangles * 3 * (t + 1) / threadCount;
+        for (size_t c = begin; c < end; c++) {
+            uint64_t key = edgeKey(c);
+            bool skip = faceNormals[c / 3] == glm::vec3(0.0f) || (uint32_t)key == (uint32_t)(key >> 32);
+            shardOf[c] = (uint8_t)(skip ? threadCount : (key * 0x9E3779B97F4A7C15ull >> 32) % threadCount);
+        }
+    });
+    shardOf.resize(triangles * 3);
+    partition();
+    std::vector<uint8_t>().swap(shardOf);
+
+    // Match edges: the first face of an edge is remembered, the second decides whether it
+    // is a crease or a silhouette candidate, more make it non-manifold
+    struct EdgeFaces {
+        size_t corner0, corner1;    // edge corners in the first face, second face's copy of corner1
+        size_t otherCorner1 = 0;
+        glm::vec3 normal0, normal1;
+        uint32_t faces = 0;
+    };
+    struct Candidate {
+        size_t corner0, corner1;
+        glm::vec3 normal0, normal1;
+    };
+    const float cosThreshold = std::cos(glm::radians(featureAngle));
+    std::vector<std::vector<size_t>> shardFeatures(threadCount);
+    std::vector<std::vector<Candidate>> shardCandidates(threadCount);
+    runThreads([&](unsigned int t) {
+        std::unordered_map<uint64_t, EdgeFaces> edges;
+        for (size_t k = shardStarts[t]; k < shardStarts[t + 1]; k++) {
+            size_t a = order[k], b = a - a % 3 + (a + 1) % 3;
+            const glm::vec3& normal = faceNormals[a / 3];
+            EdgeFaces& edge = edges[edgeKey(a)];
+            if (edge.faces == 0) {
+                edge.corner0 = a;
+                edge.corner1 = b;
+                edge.normal0 = normal;
+            } else if (edge.faces == 1) {
+                edge.otherCorner1 = ids[a] == ids[edge.corner1] ? a : b;
+                edge.normal1 = normal;
+            }
+            edge.faces++;
+        }
+        for (const auto& entry : edges) {
+            const EdgeFaces& edge = entry.second;
+            if (edge.faces == 2 && glm::dot(edge.normal0, edge.normal1) >= cosThreshold) {
+                shardCandidates[t].push_back({edge.corner0, edge.otherCorner1, edge.normal0, edge.normal1});
+            } else {
+                shardFeatures[t].push_back(std::min(edge.corner0, edge.corner1));
+                shardFeatures[t].push_back(std::max(edge.corner0, edge.corner1));
+            }
+        }
+    });
+    std::vector<size_t>().swap(order);
+    std::vector<glm::vec3>().swap(faceNormals);
+    std::vector<uint32_t>().swap(ids);
+
+    // Feature edges sorted by corner, so each batch's edges are one run
+    std::vector<std::pair<size_t, size_t>> features;
+    for (const auto& shard : shardFeatures) {
+        for (size_t i = 0; i < shard.size(); i += 2) {
+            features.push_back(std::make_pair(shard[i], shard[i + 1]));
+        }
+    }
+    std::sort(features.begin(), features.end());
+    featureEdges.clear();
+    featureEdges.reserve(features.size() * 2);
+    for (const auto& edge : features) {
+        featureEdges.push_back(edge.first);
+        featureEdges.push_back(edge.second);
+    }
+
+    // Silhouette candidates in face order, which keeps clusters spatially coherent
+    std::vector<Candidate> candidates;
+    for (auto& shard : shardCandidates) {
+        candidates.insert(candidates.end(), shard.begin(), shard.end());
+        std::vector<Candidate>().swap(shard);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.corner0 < b.corner0;
+    });
+    glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (const auto& candidate : candidates) {
+        minBound = glm::min(minBound, glm::min(vertices[candidate.corner0], vertices[candidate.corner1]));
+        maxBound = glm::max(maxBound, glm::max(vertices[candidate.corner0], vertices[candidate.corner1]));
+    }
+    silhouetteOrigin = candidates.empty() ? glm::vec3(0.0f) : minBound;
+    silhouetteExtent = candidates.empty() ? glm::vec3(0.0f) : maxBound - minBound;
+    glm::vec3 scale = glm::vec3(
+        silhouetteExtent.x > 0.0f ? 65535.0f / silhouetteExtent.x : 0.0f,
+        silhouetteExtent.y > 0.0f ? 65535.0f / silhouetteExtent.y : 0.0f,
+        silhouetteExtent.z > 0.0f ? 65535.0f / silhouetteExtent.z : 0.0f);
+
+    silhouetteVertices.clear();
+    silhouetteVertices.reserve(candidates.size() * 2);
+    edgeClusters.clear();
+    for (size_t first = 0; first < candidates.size(); first += edgeClusterSize) {
+        size_t end = std::min(first + edgeClusterSize, candidates.size());
+        EdgeCluster cluster;
+        cluster.first = (GLint)(first * 2);
+        cluster.count = (GLsizei)((end - first) * 2);
+
+        glm::vec3 clusterMin(FLT_MAX), clusterMax(-FLT_MAX), normalSum(0.0f);
+        for (size_t i = first; i < end; i++) {
+            const Candidate& candidate = candidates[i];
+            glm::vec2 e0 = encodeOctahedral(candidate.normal0), e1 = encodeOctahedral(candidate.normal1);
+            for (size_t corner : {candidate.corner0, candidate.corner1}) {
+                glm::vec3 q = (vertices[corner] - silhouetteOrigin) * scale + glm::vec3(0.5f);
+                SilhouetteVertex vertex;
+                vertex.position[0] = (uint16_t)q.x;
+                vertex.position[1] = (uint16_t)q.y;
+                vertex.position[2] = (uint16_t)q.z;
+                vertex.position[3] = 0;
+                vertex.faceNormals[0] = (int16_t)std::round(glm::clamp(e0.x, -1.0f, 1.0f) * 32767.0f);
+                vertex.faceNormals[1] = (int16_t)std::round(glm::clamp(e0.y, -1.0f, 1.0f) * 32767.0f);
+                vertex.faceNormals[2] = (int16_t)std::round(glm::clamp(e1.x, -1.0f, 1.0f) * 32767.0f);
+                vertex.faceNormals[3] = (int16_t)std::round(glm::clamp(e1.y, -1.0f, 1.0f) * 32767.0f);
+                silhouetteVertices.push_back(vertex);
+                clusterMin = glm::min(clusterMin, vertices[corner]);
+                clusterMax = glm::max(clusterMax, vertices[corner]);
+            }
+            normalSum += candidate.normal0 + candidate.normal1;
+        }
+
+        glm::vec3 center = (clusterMin + clusterMax) * 0.5f;
+        cluster.sphere = glm::vec4(center, glm::length(clusterMax - center));
+        float sumLength = glm::length(normalSum);
+        cluster.coneAngle = glm::pi<float>();
+        if (sumLength > 1e-6f) {
+            cluster.axis = normalSum / sumLength;
+            float minCos = 1.0f;
+            for (size_t i = first; i < end; i++) {
+                minCos = std::min(minCos, std::min(glm::dot(cluster.axis, candidates[i].normal0),
+                                                   glm::dot(cluster.axis, candidates[i].normal1)));
+            }
+            cluster.coneAngle = std::acos(glm::clamp(minCos, -1.0f, 1.0f));
+        }
+        edgeClusters.push_back(cluster);
+    }
+    std::cout << "Edges: " << features.size() << " feature, " << candidates.size() << " silhouette candidates" << std::endl;
+}
+
+// Uploads the feature edges among the batch's corners as a line index buffer of its vertex array
+void uploadFeatureEdges(MeshBatch& batch) {
+    if (!batch.uploaded) return;
+    const size_t end = batch.first + batch.count;
+    // Binary search over the pairs for the first edge starting in the batch
+    size_t low = 0, high = featureEdges.size() / 2;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (featureEdges[2 * middle] < batch.first) low = middle + 1;
+        else high = middle;
+    }
+    std::vector<uint32_t> indices;
+    for (size_t i = 2 * low; i < featureEdges.size() && featureEdges[i] < end; i += 2) {
+        indices.push_back((uint32_t)(featureEdges[i] - batch.first));
+        indices.push_back((uint32_t)(featureEdges[i + 1] - batch.first));
+    }
+    if (indices.empty()) return;
+
+    glBindVertexArray(batch.VAO);
+    glGenBuffers(1, &batch.EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    batch.edgeCount = (GLsizei)(indices.size() / 2);
+}
+
+void drawFeatureEdges(GLuint program, const std::vector<MeshBatch>& batches) {
+    for (const auto& batch : batches) {
+        if (!batch.uploaded || batch.edgeCount == 0) continue;
+        bindMeshBatch(program, batch);
+        glDrawElements(GL_LINES, batch.edgeCount * 2, GL_UNSIGNED_INT, (void*)0);
+    }
+}
+
+// Bounds of every sectionClusterCorners corners, in file order
+void buildSectionClusters(const std::vector<glm::vec3>& vertices) {
+    sectionClusters.clear();
+    sectionClusters.reserve((vertices.size() + sectionClusterCorners - 1) / sectionClusterCorners);
+    for (size_t first = 0; first < vertices.size(); first += sectionClusterCorners) {
+        size_t end = std::min(first + sectionClusterCorners, vertices.size());
+        SectionCluster cluster;
+        cluster.minBound = cluster.maxBound = vertices[first];
+        for (size_t i = first + 1; i < end; i++) {
+            cluster.minBound = glm::min(cluster.minBound, vertices[i]);
+            cluster.maxBound = glm::max(cluster.maxBound, vertices[i]);
+        }
+        sectionClusters.push_back(cluster);
+    }
+}
+
+// Maps the section planes from the normalized frame to model space for this frame
+void updateSectionPlanes(const glm::vec3& center, float radius) {
+    for (int p = 0; p < maxSectionPlanes; p++) {
+        glm::vec3 normal = glm::vec3(sectionPlanes[p]);
+        sectionModelPlanes[p] = p < sectionPlaneCount
+            ? glm::vec4(normal / radius, sectionPlanes[p].w - glm::dot(normal, center) / radius)
+            : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+// Clips with the section planes in `mask`. Programs that don't write gl_ClipDistance must
+// be drawn with none enabled.
+void enableSectionPlanes(unsigned int mask) {
+    for (int p = 0; p < maxSectionPlanes; p++) {
+        if (mask & (1u << p)) {
+            glEnable(GL_CLIP_DISTANCE0 + p);
         } else {
-            // Solid rendering
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glDisable(GL_CLIP_DISTANCE0 + p);
+        }
+    }
+}
+
+// Whether a model-space sphere lies entirely on the removed side of a plane in `mask`
+bool sectionClipsSphere(const glm::vec3& center, float radius, unsigned int mask) {
+    for (int p = 0; p < sectionPlaneCount; p++) {
+        if (!(mask & (1u << p))) continue;
+        const glm::vec4& plane = sectionModelPlanes[p];
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane))) return true;
+    }
+    return false;
+}
+
+// Corner ranges of the section clusters that keep a part on the kept side of every plane in
+// `mask`; corners after the last cluster (patches split into triangles) are always kept
+void selectSectionRanges(unsigned int mask, std::vector<std::pair<size_t, size_t>>& ranges) {
+    ranges.clear();
+    for (size_t c = 0; c < sectionClusters.size(); c++) {
+        const SectionCluster& cluster = sectionClusters[c];
+        bool clipped = false;
+        for (int p = 0; p < sectionPlaneCount && !clipped; p++) {
+            if (!(mask & (1u << p))) continue;
+            // The box corner furthest along the plane normal
+            const glm::vec4& plane = sectionModelPlanes[p];
+            glm::vec3 corner(plane.x >= 0.0f ? cluster.maxBound.x : cluster.minBound.x,
+                             plane.y >= 0.0f ? cluster.maxBound.y : cluster.minBound.y,
+                             plane.z >= 0.0f ? cluster.maxBound.z : cluster.minBound.z);
+            clipped = glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f;
+        }
+        if (clipped) continue;
+
+        size_t first = c * sectionClusterCorners;
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == first) {
+            ranges.back().second += sectionClusterCorners;
+        } else {
+            ranges.push_back(std::make_pair(first, sectionClusterCorners));
+        }
+    }
+    size_t tail = sectionClusters.size() * sectionClusterCorners;
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == tail) {
+        ranges.back().second = SIZE_MAX - ranges.back().first;
+    } else {
+        ranges.push_back(std::make_pair(tail, SIZE_MAX - tail));
+    }
+}
+
+// Corner ranges of the section clusters whose bounds reach into the frustum of
+// `modelViewProjection`, skipping the clusters of objects whose bounding sphere lies outside
+// it; corners after the last cluster are always kept
+void selectFrustumRanges(const glm::mat4& modelViewProjection, const std::vector<SceneObject>& objects,
+                         std::vector<std::pair<size_t, size_t>>& ranges) {
+    glm::mat4 m = glm::transpose(modelViewProjection);
+    glm::vec4 planes[6] = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]};
+    auto outside = [&](const glm::vec3& minBound, const glm::vec3& maxBound) {
+        for (const auto& plane : planes) {
+            glm::vec3 corner(plane.x >= 0.0f ? maxBound.x : minBound.x,
+                             plane.y >= 0.0f ? maxBound.y : minBound.y,
+                             plane.z >= 0.0f ? maxBound.z : minBound.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return true;
+        }
+        return false;
+    };
+    auto keep = [&](size_t first, size_t end) {
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == first) {
+            ranges.back().second = end - ranges.back().first;
+        } else {
+            ranges.push_back(std::make_pair(first, end - first));
+        }
+    };
+
+    // Whole objects first, then the clusters of the corners left
+    std::vector<std::pair<size_t, size_t>> objectRanges;
+    size_t cursor = 0;
+    for (const auto& object : objects) {
+        glm::vec3 extent(object.radius);
+        if (!outside(object.center - extent, object.center + extent)) continue;
+        if (object.first > cursor) {
+            objectRanges.push_back(std::make_pair(cursor, object.first - cursor));
+        }
+        cursor = object.first + object.count;
+    }
+    objectRanges.push_back(std::make_pair(cursor, SIZE_MAX - cursor));
+
+    ranges.clear();
+    const size_t tail = sectionClusters.size() * sectionClusterCorners;
+    for (const auto& range : objectRanges) {
+        const size_t end = range.first + range.second;
+        for (size_t c = range.first / sectionClusterCorners; c < sectionClusters.size() && c * sectionClusterCorners < end; c++) {
+            if (outside(sectionClusters[c].minBound, sectionClusters[c].maxBound)) continue;
+            keep(std::max(range.first, c * sectionClusterCorners), std::min(end, (c + 1) * sectionClusterCorners));
+        }
+        if (end > tail) {
+            keep(std::max(range.first, tail), end);
+        }
+    }
+}
+
+// Draws a square in section plane `plane` covering the model's bounding sphere
+void drawSectionCap(GLuint vbo, int plane, const glm::vec3& center, float radius) {
+    glm::vec3 normal = glm::vec3(sectionPlanes[plane]);
+    glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 u = glm::normalize(glm::cross(normal, axis)) * 1.5f;
+    glm::vec3 v = glm::cross(normal, u);
+    glm::vec3 origin = -sectionPlanes[plane].w * normal;
+    glm::vec3 corners[4] = {origin - u - v, origin + u - v, origin - u + v, origin + u + v};
+    for (auto& corner : corners) {
+        corner = center + corner * radius;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(corners), corners);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// Edge of the mesh identified by its end positions in a fixed order, so the two triangles
+// sharing it compute the same crossing point and the segments join up
+struct SliceEdgeKey {
+    glm::vec3 a, b;
+
+    bool operator==(const SliceEdgeKey& other) const {
+        return a == other.a && b == other.b;
+    }
+};
+
+struct SliceEdgeKeyHash {
+    size_t operator()(const SliceEdgeKey& key) const {
+        glm::vec3 positions[2] = {key.a + glm::vec3(0.0f), key.b + glm::vec3(0.0f)};
+        return (size_t)hashBytes(positions, sizeof(positions));
+    }
+};
+
+// Cuts the listed triangles with the plane at `slice.height` along `axis` and stitches the
+// segments into polylines. A vertex on the plane counts as above it, so every crossing
+// triangle has exactly two crossing edges.
+void sliceTriangles(const std::vector<glm::vec3>& vertices, const size_t* triangles, size_t count, int axis,
+                    MeshSlice& slice) {
+    const uint32_t none = UINT32_MAX;
+    const float h = slice.height;
+    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    std::unordered_map<SliceEdgeKey, uint32_t, SliceEdgeKeyHash> nodeIds;
+    std::vector<glm::vec2> nodes;
+    std::vector<std::pair<uint32_t, uint32_t>> links;   // two neighbours per node; more are non-manifold and dropped
+
+    auto crossing = [&](glm::vec3 a, glm::vec3 b) {
+        if (b[0] < a[0] || (b[0] == a[0] && (b[1] < a[1] || (b[1] == a[1] && b[2] < a[2])))) {
+            std::swap(a, b);
+        }
+        auto inserted = nodeIds.emplace(SliceEdgeKey{a, b}, (uint32_t)nodes.size());
+        if (inserted.second) {
+            float t = (h - a[axis]) / (b[axis] - a[axis]);
+            glm::vec3 p = a + (b - a) * t;
+            nodes.push_back(glm::vec2(p[u], p[v]));
+            links.push_back(std::make_pair(none, none));
+        }
+        return inserted.first->second;
+    };
+    auto link = [&](uint32_t from, uint32_t to) {
+        if (links[from].first == none) links[from].first = to;
+        else if (links[from].second == none) links[from].second = to;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3* corners = &vertices[3 * triangles[i]];
+        uint32_t ends[2];
+        int found = 0;
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3& a = corners[e];
+            const glm::vec3& b = corners[(e + 1) % 3];
+            if ((a[axis] >= h) != (b[axis] >= h)) {
+                ends[found++] = crossing(a, b);
+            }
+        }
+        if (found == 2 && ends[0] != ends[1]) {
+            link(ends[0], ends[1]);
+            link(ends[1], ends[0]);
+        }
+    }
+
+    // Open chains first, from their ends, then the closed loops that remain
+    std::vector<bool> visited(nodes.size(), false);
+    auto walk = [&](uint32_t start) {
+        SlicePolyline polyline;
+        uint32_t previous = none, current = start;
+        while (true) {
+            visited[current] = true;
+            polyline.points.push_back(nodes[current]);
+            uint32_t next = none;
+            for (uint32_t candidate : {links[current].first, links[current].second}) {
+                if (candidate == none || candidate == previous) continue;
+                if (candidate == start && polyline.points.size() > 2) {
+                    polyline.closed = true;
+                    break;
+                }
+                if (!visited[candidate]) {
+                    next = candidate;
+                    break;
+                }
+            }
+            if (polyline.closed || next == none) break;
+            previous = current;
+            current = next;
+        }
+        if (polyline.points.size() > 1) {
+            slice.polylines.push_back(std::move(polyline));
+        }
+    };
+    for (uint32_t n = 0; n < nodes.size(); n++) {
+        if (!visited[n] && links[n].second == none) walk(n);
+    }
+    for (uint32_t n = 0; n < nodes.size(); n++) {
+        if (!visited[n]) walk(n);
+    }
+}
+
+// Slices the triangle soup with the planes perpendicular to `axis` at every multiple of
+// `step`. Triangles are bucketed by the planes their extent along the axis spans, in parallel
+// over the triangles (a counting sort with one histogram per thread); then the threads take
+// planes one at a time, so the cost splits evenly however the triangles are distributed.
+bool sliceMesh(const std::vector<glm::vec3>& vertices, int axis, float step, std::vector<MeshSlice>& slices) {
+    slices.clear();
+    const size_t triangles = vertices.size() / 3;
+    if (triangles == 0) return false;
+    float low = FLT_MAX, high = -FLT_MAX;
+    for (const auto& vertex : vertices) {
+        low = std::min(low, vertex[axis]);
+        high = std::max(high, vertex[axis]);
+    }
+    const double first = std::ceil((double)low / step) * step;
+    if (first > high) return false;
+    const size_t planeCount = (size_t)std::floor((high - first) / step) + 1;
+    if (planeCount > maxSlicePlanes) {
+        std::cerr << "Too many slicing planes (" << planeCount << ", at most " << maxSlicePlanes << ")" << std::endl;
+        return false;
+    }
+    slices.resize(planeCount);
+    for (size_t k = 0; k < planeCount; k++) {
+        slices[k].height = (float)(first + k * (double)step);
+    }
+
+    // Planes a triangle may cross, widened by one on each side against rounding; the exact
+    // test is made when slicing
+    auto planeRange = [&](size_t t, size_t& begin, size_t& end) {
+        const glm::vec3* corners = &vertices[3 * t];
+        float minimum = std::min(corners[0][axis], std::min(corners[1][axis], corners[2][axis]));
+        float maximum = std::max(corners[0][axis], std::max(corners[1][axis], corners[2][axis]));
+        double lowPlane = std::floor((minimum - first) / step);
+        double highPlane = std::floor((maximum - first) / step) + 2.0;
+        begin = (size_t)std::max(0.0, lowPlane);
+        end = (size_t)std::min((double)planeCount, std::max(0.0, highPlane));
+    };
+
+    const unsigned int threadCount = std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+    auto runThreads = [&](const std::function<void(unsigned int)>& work) {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < threadCount; t++) {
+            threads.emplace_back(work, t);
+        }
+        for (auto& thread : threads) {
+            thread.join();
         }
-        
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-        
-        // Reset polygon mode for next frame if needed
-        if (showWireframe) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    };
+
+    // Bucket offsets ordered by plane, then thread, so each plane's triangles stay in file order
+    std::vector<size_t> offsets((size_t)planeCount * threadCount + 1, 0);
+    runThreads([&](unsigned int t) {
+        size_t begin, end;
+        for (size_t i = triangles * t / threadCount; i < triangles * (t + 1) / threadCount; i++) {
+            planeRange(i, begin, end);
+            for (size_t k = begin; k < end; k++) {
+                offsets[k * threadCount + t + 1]++;
+            }
         }
-        
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    });
+    for (size_t i = 1; i < offsets.size(); i++) {
+        offsets[i] += offsets[i - 1];
     }
+    std::vector<size_t> buckets(offsets.back());
+    runThreads([&](unsigned int t) {
+        size_t begin, end;
+        for (size_t i = triangles * t / threadCount; i < triangles * (t + 1) / threadCount; i++) {
+            planeRange(i, begin, end);
+            for (size_t k = begin; k < end; k++) {
+                buckets[offsets[k * threadCount + t]++] = i;
+            }
+        }
+    });
+    // Each bucket's offset now points at its end, which is where the next one starts
 
-    // Clean up
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &NBO);
-    glDeleteProgram(shaderProgram);
-
-    glfwTerminate();
-    return 0;
+    std::atomic<size_t> nextPlane(0);
+    runThreads([&](unsigned int) {
+        for (size_t k = nextPlane++; k < planeCount; k = nextPlane++) {
+            size_t begin = k == 0 ? 0 : offsets[k * threadCount - 1];
+            size_t end = offsets[(k + 1) * threadCount - 1];
+            sliceTriangles(vertices, buckets.data() + begin, end - begin, axis, slices[k]);
+        }
+    });
+    return true;
 }
 
-GLuint compileShaders() {
-    // Vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
+// Writes each slice as a group of paths in the plane's other two coordinates (y up)
+bool writeSlicesSVG(const std::string& path, const std::vector<MeshSlice>& slices, int axis) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Cannot write slices: " << path << std::endl;
+        return false;
+    }
+    glm::vec2 minBound(FLT_MAX), maxBound(-FLT_MAX);
+    for (const auto& slice : slices) {
+        for (const auto& polyline : slice.polylines) {
+            for (const auto& point : polyline.points) {
+                minBound = glm::min(minBound, point);
+                maxBound = glm::max(maxBound, point);
+            }
+        }
+    }
+    if (minBound.x > maxBound.x) {
+        minBound = maxBound = glm::vec2(0.0f);
+    }
 
-    // Check for compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
+    const char* axisNames = "xyz";
+    file.precision(9);
+    file << "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"" << minBound.x << " " << -maxBound.y << " "
+         << maxBound.x - minBound.x << " " << maxBound.y - minBound.y << "\">\n";
+    for (size_t k = 0; k < slices.size(); k++) {
+        if (slices[k].polylines.empty()) continue;
+        file << "<g id=\"slice-" << k << "\" data-" << axisNames[axis] << "=\"" << slices[k].height
+             << "\" fill=\"none\" stroke=\"black\" stroke-width=\"1\" vector-effect=\"non-scaling-stroke\">\n";
+        for (const auto& polyline : slices[k].polylines) {
+            file << "<path d=\"";
+            for (size_t i = 0; i < polyline.points.size(); i++) {
+                file << (i == 0 ? "M" : " L") << polyline.points[i].x << " " << -polyline.points[i].y;
+            }
+            file << (polyline.closed ? " Z" : "") << "\"/>\n";
+        }
+        file << "</g>\n";
     }
+    file << "</svg>\n";
+    return true;
+}
 
-    // Fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
+// Writes one row per polyline point: slice, plane coordinate, polyline, whether it is closed
+// and the point's two other coordinates
+bool writeSlicesCSV(const std::string& path, const std::vector<MeshSlice>& slices, int axis) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Cannot write slices: " << path << std::endl;
+        return false;
+    }
+    const char* axisNames = "xyz";
+    file.precision(9);
+    file << "slice," << axisNames[axis] << ",polyline,closed," << axisNames[(axis + 1) % 3] << ","
+         << axisNames[(axis + 2) % 3] << "\n";
+    for (size_t k = 0; k < slices.size(); k++) {
+        for (size_t p = 0; p < slices[k].polylines.size(); p++) {
+            const SlicePolyline& polyline = slices[k].polylines[p];
+            for (const auto& point : polyline.points) {
+                file << k << "," << slices[k].height << "," << p << "," << (polyline.closed ? 1 : 0) << ","
+                     << point.x << "," << point.y << "\n";
+            }
+        }
+    }
+    return true;
+}
 
-    // Check for compilation errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
+// Loads one model for a thumbnail run. Models load in parallel: only gathering the output,
+// which also appends to the viewer's object and material lists, is serialized.
+bool loadThumbnailMesh(Thumbnail& thumbnail) {
+    if (endsWith(toLower(thumbnail.path), ".zip")) {
+        std::cerr << "Zip bundles are not supported for thumbnails: " << thumbnail.path << std::endl;
+        return false;
     }
+    MappedFile file;
+    if (!mapFile(thumbnail.path.c_str(), file)) {
+        std::cerr << "Cannot open file: " << thumbnail.path << std::endl;
+        unmapFile(file);
+        return false;
+    }
+    OBJParseState state;
+    parseOBJLines(file.data, file.size, 0, true, state, NULL);
+    unmapFile(file);
 
-    // Link shaders
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    // Quads kept as patches under --tessellate are drawn as triangles here
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> patches, patchNormals;
+    {
+        std::lock_guard<std::mutex> lock(thumbnailLoadMutex);
+        buildOBJOutput(state, thumbnail.vertices, thumbnail.normals, uvs, patches, patchNormals);
+        sceneObjects.clear();
+        materialRanges.clear();
+        materialLibraries.clear();
+    }
+    appendPatchesAsTriangles(thumbnail.vertices, thumbnail.normals, patches, patchNormals);
+    if (thumbnail.vertices.empty()) {
+        std::cerr << "No triangles in " << thumbnail.path << std::endl;
+        return false;
+    }
+    if (thumbnail.normals.size() != thumbnail.vertices.size()) {
+        thumbnail.normals.assign(thumbnail.vertices.size(), glm::vec3(0.0f));
+        calculateSmoothNormals(thumbnail.vertices, thumbnail.normals);
+    }
 
-    // Check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-        return 0;
+    // Framed like the viewer frames a model
+    glm::vec3 center(0.0f);
+    for (const auto& vertex : thumbnail.vertices) {
+        center += vertex;
     }
+    center /= (float)thumbnail.vertices.size();
+    float radius = 0.0f;
+    for (const auto& vertex : thumbnail.vertices) {
+        radius = std::max(radius, glm::length(vertex - center));
+    }
+    thumbnail.center = center;
+    thumbnail.radius = radius > 0.0f ? radius : 1.0f;
+    return true;
+}
 
-    // Delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+// Encodes 8-bit RGBA rows, given top to bottom `stride` bytes apart, as a PNG file
+bool writePNG(const std::string& path, int width, int height, const unsigned char* rgba, ptrdiff_t stride) {
+    // Every row starts with its filter type, 0 (none)
+    const size_t rowSize = (size_t)width * 4 + 1;
+    std::vector<unsigned char> raw(rowSize * height);
+    for (int y = 0; y < height; y++) {
+        raw[y * rowSize] = 0;
+        memcpy(&raw[y * rowSize + 1], rgba + y * stride, (size_t)width * 4);
+    }
+    uLongf compressedSize = compressBound((uLong)raw.size());
+    std::vector<unsigned char> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, raw.data(), (uLong)raw.size(), 6) != Z_OK) {
+        return false;
+    }
 
-    return shaderProgram;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot write thumbnail: " << path << std::endl;
+        return false;
+    }
+    auto writeBE32 = [&](uint32_t value) {
+        const char bytes[4] = {(char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value};
+        file.write(bytes, 4);
+    };
+    auto writeChunk = [&](const char* type, const unsigned char* data, size_t size) {
+        writeBE32((uint32_t)size);
+        file.write(type, 4);
+        file.write((const char*)data, size);
+        uLong crc = crc32(0L, (const Bytef*)type, 4);
+        if (size > 0) {
+            crc = crc32(crc, data, (uInt)size);     // a null buffer would restart the CRC
+        }
+        writeBE32((uint32_t)crc);
+    };
+    file.write("\x89PNG\r\n\x1a\n", 8);
+    unsigned char header[13] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        8, 6, 0, 0, 0};  // 8-bit RGBA, deflate, no interlacing
+    writeChunk("IHDR", header, sizeof(header));
+    writeChunk("IDAT", compressed.data(), compressedSize);
+    writeChunk("IEND", NULL, 0);
+    return file.good();
 }
 
-struct VertexKey {
-    glm::vec3 position;
-    
-    bool operator<(const VertexKey& other) const {
-        if (position.x != other.position.x) return position.x < other.position.x;
-        if (position.y != other.position.y) return position.y < other.position.y;
-        return position.z < other.position.z;
+// Renders thumbnails of all `paths` in pages: the page's models are loaded in parallel and
+// uploaded into one pair of buffers, drawn one viewport per tile with the same program and
+// state into a multisampled framebuffer, resolved and read back with a single glReadPixels.
+// Worker threads then cut the page into tiles and encode them while the next page renders.
+bool renderThumbnails(const std::vector<const char*>& paths) {
+    std::error_code error;
+    std::filesystem::create_directories(thumbnailDirectory, error);
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return false;
     }
-};
+    GLFWwindow* window = createWindow(3, 3);
+    if (window == NULL) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    GLuint program = compileShaders(vertexShaderSource, fragmentShaderSource);
+    if (program == 0) {
+        glfwTerminate();
+        return false;
+    }
+    setSceneSamplerUnits(program);
 
-bool loadOBJ(const char* path, 
-             std::vector<glm::vec3>& out_vertices, 
-             std::vector<glm::vec3>& out_normals, 
-             std::vector<glm::vec2>& out_uvs) {
-    
-    std::vector<glm::vec3> temp_vertices;
-    std::vector<glm::vec2> temp_uvs;
-    std::vector<glm::vec3> temp_normals;
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    // Output names from the model stems; a stem seen before gets the first free -2, -3, ...
+    std::vector<std::string> names(paths.size());
+    std::map<std::string, int> usedNames;
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::string stem = std::filesystem::path(paths[i]).stem().string();
+        std::string name = stem;
+        for (int suffix = 2; usedNames.count(name); suffix++) {
+            name = stem + "-" + std::to_string(suffix);
+        }
+        usedNames[name] = 1;
+        names[i] = (std::filesystem::path(thumbnailDirectory) / name).string() + ".png";
+    }
 
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Cannot open file: " << path << std::endl;
-        return false;
+    // The page: as many tiles as fit, no more than there are models
+    GLint maxSize = 0, maxSamples = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    thumbnailSize = std::min(thumbnailSize, (int)maxSize);
+    const int columns = std::max(1, std::min(thumbnailPageSize, (int)maxSize) / thumbnailSize);
+    const int rows = (int)std::min<size_t>(columns, (paths.size() + columns - 1) / columns);
+    const int pageWidth = columns * thumbnailSize, pageHeight = rows * thumbnailSize;
+    const size_t tilesPerPage = (size_t)columns * rows;
+
+    GLuint renderbuffers[3];
+    GLuint framebuffers[2];
+    glGenRenderbuffers(3, renderbuffers);
+    glGenFramebuffers(2, framebuffers);
+    const GLsizei samples = std::min(8, (int)maxSamples);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, pageWidth, pageHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, pageWidth, pageHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[2]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, pageWidth, pageHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[2]);
+    complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) {
+        std::cerr << "Cannot create a " << pageWidth << "x" << pageHeight << " thumbnail page" << std::endl;
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
+    GLuint VAO, buffers[2];
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(2, buffers);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttrib4f(2, 0.0f, 0.0f, 0.0f, 1.0f);
 
-        if (prefix == "v") {
-            glm::vec3 vertex;
-            iss >> vertex.x >> vertex.y >> vertex.z;
-            temp_vertices.push_back(vertex);
-        } else if (prefix == "vt") {
-            glm::vec2 uv;
-            iss >> uv.x >> uv.y;
-            temp_uvs.push_back(uv);
-        } else if (prefix == "vn") {
-            glm::vec3 normal;
-            iss >> normal.x >> normal.y >> normal.z;
-            temp_normals.push_back(normal);
-        } else if (prefix == "f") {
-            std::string vertex1, vertex2, vertex3;
-            iss >> vertex1 >> vertex2 >> vertex3;
-            
-            // Handle faces with more than 3 vertices (triangulation)
-            std::string vertex4;
-            iss >> vertex4;
-            bool isQuad = !vertex4.empty();
-            
-            std::vector<std::string> face_vertices;
-            face_vertices.push_back(vertex1);
-            face_vertices.push_back(vertex2);
-            face_vertices.push_back(vertex3);
-            
-            if (isQuad) {
-                // For quads, add another triangle
-                face_vertices.push_back(vertex1); // Reuse vertex1
-                face_vertices.push_back(vertex3); // Reuse vertex3
-                face_vertices.push_back(vertex4);
-            }
-            
-            // Process each triangle in the face
-            for (size_t v = 0; v < face_vertices.size(); v += 3) {
-                for (size_t i = 0; i < 3; i++) {
-                    std::string vertex = face_vertices[v + i];
-                    std::istringstream viss(vertex);
-                    std::string token;
-                    
-                    // Parse vertex index
-                    std::getline(viss, token, '/');
-                    int vertexIndex = std::stoi(token);
-                    vertexIndices.push_back(vertexIndex);
-                    
-                    // Parse texture coordinate index (if present)
-                    if (std::getline(viss, token, '/')) {
-                        if (!token.empty()) {
-                            int uvIndex = std::stoi(token);
-                            uvIndices.push_back(uvIndex);
-                        }
-                    }
-                    
-                    // Parse normal index (if present)
-                    if (std::getline(viss, token, '/')) {
-                        if (!token.empty()) {
-                            int normalIndex = std::stoi(token);
-                            normalIndices.push_back(normalIndex);
-                        }
-                    }
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+    glUseProgram(program);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    // A three-quarter view, the same for every model
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    const glm::mat4 turn = glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(25.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+                                       glm::radians(-35.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    const unsigned int threadCount = std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+    std::vector<std::future<size_t>> encoders;
+    size_t written = 0;
+    for (size_t pageFirst = 0; complete && pageFirst < paths.size(); pageFirst += tilesPerPage) {
+        std::vector<Thumbnail> page(std::min(tilesPerPage, paths.size() - pageFirst));
+        std::atomic<size_t> nextModel(0);
+        std::vector<std::thread> loaders;
+        for (unsigned int t = 0; t < threadCount; t++) {
+            loaders.emplace_back([&]() {
+                for (size_t i = nextModel++; i < page.size(); i = nextModel++) {
+                    page[i].path = paths[pageFirst + i];
+                    page[i].loaded = loadThumbnailMesh(page[i]);
                 }
-            }
+            });
+        }
+        for (auto& loader : loaders) {
+            loader.join();
         }
-    }
 
-    // Process vertex indices (OBJ uses 1-based indexing)
-    for (size_t i = 0; i < vertexIndices.size(); i++) {
-        if (vertexIndices[i] > 0 && vertexIndices[i] <= temp_vertices.size()) {
-            glm::vec3 vertex = temp_vertices[vertexIndices[i] - 1];
-            out_vertices.push_back(vertex);
-            
-            // Process texture coordinates if available
-            if (!uvIndices.empty() && i < uvIndices.size() && 
-                uvIndices[i] > 0 && uvIndices[i] <= temp_uvs.size()) {
-                out_uvs.push_back(temp_uvs[uvIndices[i] - 1]);
-            } else if (!temp_uvs.empty()) {
-                out_uvs.push_back(glm::vec2(0.0f, 0.0f));
-            }
-            
-            // Process normals if available
-            if (!normalIndices.empty() && i < normalIndices.size() && 
-                normalIndices[i] > 0 && normalIndices[i] <= temp_normals.size()) {
-                out_normals.push_back(temp_normals[normalIndices[i] - 1]);
+        // One upload of the whole page
+        size_t corners = 0;
+        for (auto& thumbnail : page) {
+            thumbnail.first = (GLint)corners;
+            corners += thumbnail.vertices.size();
+        }
+        for (int b = 0; b < 2; b++) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[b]);
+            glBufferData(GL_ARRAY_BUFFER, corners * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+            for (auto& thumbnail : page) {
+                const std::vector<glm::vec3>& data = b == 0 ? thumbnail.vertices : thumbnail.normals;
+                glBufferSubData(GL_ARRAY_BUFFER, thumbnail.first * sizeof(glm::vec3), data.size() * sizeof(glm::vec3), data.data());
             }
         }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+        glViewport(0, 0, pageWidth, pageHeight);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        setSceneUniforms(program, glm::mat4(1.0f), view, projection, false);
+        for (size_t i = 0; i < page.size(); i++) {
+            if (!page[i].loaded) continue;
+            glViewport((int)(i % columns) * thumbnailSize, (int)(i / columns) * thumbnailSize, thumbnailSize, thumbnailSize);
+            glm::mat4 model = glm::translate(glm::scale(turn, glm::vec3(1.0f / page[i].radius)), -page[i].center);
+            glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+            glDrawArrays(GL_TRIANGLES, page[i].first, (GLsizei)page[i].vertices.size());
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        glBlitFramebuffer(0, 0, pageWidth, pageHeight, 0, 0, pageWidth, pageHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[1]);
+        auto pixels = std::make_shared<std::vector<unsigned char>>((size_t)pageWidth * pageHeight * 4);
+        glReadPixels(0, 0, pageWidth, pageHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+
+        // Tiles are cut from the bottom-up page rows, so each is encoded from its top row down
+        std::vector<std::string> outputs(page.size());
+        for (size_t i = 0; i < page.size(); i++) {
+            if (!page[i].loaded) continue;
+            outputs[i] = names[pageFirst + i];
+        }
+        std::vector<Thumbnail>().swap(page);
+        for (unsigned int t = 0; t < threadCount; t++) {
+            encoders.push_back(std::async(std::launch::async, [=]() {
+                size_t count = 0;
+                const ptrdiff_t stride = (ptrdiff_t)pageWidth * 4;
+                for (size_t i = t; i < outputs.size(); i += threadCount) {
+                    if (outputs[i].empty()) continue;
+                    size_t x = i % columns, y = i / columns;
+                    const unsigned char* top = pixels->data() + ((y + 1) * thumbnailSize - 1) * stride + x * thumbnailSize * 4;
+                    count += writePNG(outputs[i], thumbnailSize, thumbnailSize, top, -stride);
+                }
+                return count;
+            }));
+        }
     }
+    for (auto& encoder : encoders) {
+        written += encoder.get();
+    }
+    std::cout << "Thumbnails written: " << written << " of " << paths.size() << std::endl;
 
-    return true;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(2, buffers);
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteRenderbuffers(3, renderbuffers);
+    glDeleteProgram(program);
+    glfwTerminate();
+    return complete && written == paths.size();
 }
 
-void calculateSmoothNormals(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals) {
-    // Map to store vertex position to vertex indices
-    std::map<VertexKey, std::vector<size_t>> vertexMap;
-    
-    // First, identify identical vertices
-    for (size_t i = 0; i < vertices.size(); i++) {
-        VertexKey key = {vertices[i]};
-        vertexMap[key].push_back(i);
+// Clusters that can contain a silhouette seen from `modelCamera` (in model space): some
+// direction from the camera into the cluster's sphere is perpendicular to some normal of its cone
+void selectSilhouetteClusters(const glm::vec3& modelCamera, std::vector<GLint>& firsts, std::vector<GLsizei>& counts) {
+    firsts.clear();
+    counts.clear();
+    const float halfPi = 0.5f * glm::pi<float>();
+    const unsigned int sectionMask = (1u << sectionPlaneCount) - 1;
+    for (const auto& cluster : edgeClusters) {
+        if (sectionClipsSphere(glm::vec3(cluster.sphere), cluster.sphere.w, sectionMask)) continue;
+        glm::vec3 toCluster = glm::vec3(cluster.sphere) - modelCamera;
+        float distance = glm::length(toCluster);
+        if (distance > cluster.sphere.w && cluster.coneAngle < halfPi) {
+            float spread = std::asin(cluster.sphere.w / distance);
+            float angle = std::acos(glm::clamp(glm::dot(cluster.axis, toCluster / distance), -1.0f, 1.0f));
+            if (std::fabs(angle - halfPi) > cluster.coneAngle + spread) continue;
+        }
+        if (!firsts.empty() && firsts.back() + counts.back() == cluster.first) {
+            counts.back() += cluster.count;
+        } else {
+            firsts.push_back(cluster.first);
+            counts.push_back(cluster.count);
+        }
     }
-    
-    // Calculate face normals first
-    for (size_t i = 0; i < vertices.size(); i += 3) {
-        if (i + 2 < vertices.size()) {
-            glm::vec3 v0 = vertices[i];
-            glm::vec3 v1 = vertices[i + 1];
-            glm::vec3 v2 = vertices[i + 2];
-            
-            // Calculate face normal
-            glm::vec3 edge1 = v1 - v0;
-            glm::vec3 edge2 = v2 - v0;
-            glm::vec3 faceNormal = glm::cross(edge1, edge2);
-            
-            // Accumulate this normal for each vertex of the triangle
-            normals[i] += faceNormal;
-            normals[i + 1] += faceNormal;
-            normals[i + 2] += faceNormal;
+}
+
+// Allocates one atlas layer per object large enough to benefit, up to the array limit.
+// Returns the texture array, or 0 if no object qualifies.
+GLuint createImpostorAtlas() {
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    int layers = 0;
+    for (auto& object : sceneObjects) {
+        if (object.count >= impostorMinCorners && layers < maxLayers) {
+            object.layer = layers++;
         }
     }
-    
-    // Now, average normals for identical vertices
-    for (const auto& entry : vertexMap) {
-        if (entry.second.size() > 1) {
-            // Accumulate all normals
-            glm::vec3 avgNormal(0.0f);
-            for (size_t idx : entry.second) {
-                avgNormal += normals[idx];
-            }
-            
-            // Normalize and assign back
-            avgNormal = glm::normalize(avgNormal);
-            for (size_t idx : entry.second) {
-                normals[idx] = avgNormal;
-            }
-        } else if (entry.second.size() == 1) {
-            // Just normalize single normals
-            size_t idx = entry.second[0];
-            normals[idx] = glm::normalize(normals[idx]);
+    if (layers == 0) return 0;
+
+    const int size = impostorGrid * impostorTileSize;
+    GLuint atlas = 0;
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    std::cout << "Impostors: " << layers << " objects, " << (size_t)size * size * 4 * layers / (1 << 20) << " MB" << std::endl;
+    return atlas;
+}
+
+// Renders an object into its atlas layer from every octahedral direction with an
+// orthographic camera framing its bounding sphere. The framebuffer must be bound with a
+// depth attachment of the atlas size.
+void bakeImpostor(GLuint program, const std::vector<MeshBatch>& batches, SceneObject& object, GLuint atlas) {
+    const int size = impostorGrid * impostorTileSize;
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas, 0, object.layer);
+    glViewport(0, 0, size, size);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    const float radius = std::max(object.radius, 1e-6f);
+    const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+    const std::vector<std::pair<size_t, size_t>> range(1, std::make_pair(object.first, object.count));
+    for (int y = 0; y < impostorGrid; y++) {
+        for (int x = 0; x < impostorGrid; x++) {
+            glm::vec2 cell = (glm::vec2(x, y) + 0.5f) / (float)impostorGrid * 2.0f - 1.0f;
+            glm::vec3 direction = decodeOctahedral(cell);
+            glm::vec3 reference = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(object.center + direction * 2.0f * radius, object.center, reference);
+
+            setSceneUniforms(program, glm::mat4(1.0f), view, projection, !normalStream);
+            glViewport(x * impostorTileSize, y * impostorTileSize, impostorTileSize, impostorTileSize);
+            drawMeshRanges(program, batches, range);
         }
     }
+    object.baked = true;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // The selected section plane moves while the key is held, in steps of 1% of the model's
+    // radius (10% with Shift); ] cuts deeper
+    if ((action == GLFW_PRESS || action == GLFW_REPEAT) && sectionPlaneCount > 0 &&
+        (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET)) {
+        float step = (mods & GLFW_MOD_SHIFT) ? 0.1f : 0.01f;
+        float& offset = sectionPlanes[selectedSectionPlane].w;
+        offset = glm::clamp(offset + (key == GLFW_KEY_RIGHT_BRACKET ? -step : step), -1.5f, 1.5f);
+        sectionVersion++;
+        return;
+    }
+
     if (action == GLFW_PRESS) {
+        // Direction from the camera to the model's center in its normalized frame: a plane
+        // with this normal faces the camera and removes the near side
+        glm::mat3 rotation = glm::mat3(glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f)),
+                                                   glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f)));
+        glm::vec3 viewDirection = glm::transpose(rotation) * glm::normalize(-cameraPos);
+
         switch (key) {
+            case GLFW_KEY_C:
+                if (sectionPlaneCount == maxSectionPlanes) {
+                    std::cout << "At most " << maxSectionPlanes << " section planes" << std::endl;
+                    break;
+                }
+                selectedSectionPlane = sectionPlaneCount++;
+                sectionPlanes[selectedSectionPlane] = glm::vec4(viewDirection, 0.0f);
+                sectionVersion++;
+                std::cout << "Section planes: " << sectionPlaneCount << ", selected " << selectedSectionPlane + 1 << std::endl;
+                break;
+            case GLFW_KEY_TAB:
+                if (sectionPlaneCount == 0) break;
+                selectedSectionPlane = (selectedSectionPlane + 1) % sectionPlaneCount;
+                std::cout << "Selected section plane " << selectedSectionPlane + 1 << std::endl;
+                break;
+            case GLFW_KEY_R:
+                if (sectionPlaneCount == 0) break;
+                sectionPlanes[selectedSectionPlane] = glm::vec4(viewDirection, sectionPlanes[selectedSectionPlane].w);
+                sectionVersion++;
+                break;
+            case GLFW_KEY_X:
+                if (sectionPlaneCount == 0) break;
+                for (int p = selectedSectionPlane; p + 1 < sectionPlaneCount; p++) {
+                    sectionPlanes[p] = sectionPlanes[p + 1];
+                }
+                sectionPlaneCount--;
+                selectedSectionPlane = std::max(0, std::min(selectedSectionPlane, sectionPlaneCount - 1));
+                sectionVersion++;
+                std::cout << "Section planes: " << sectionPlaneCount << std::endl;
+                break;
+            case GLFW_KEY_H:
+                capSections = !capSections;
+                std::cout << "Section caps: " << (capSections ? "ON" : "OFF") << std::endl;
+                break;
+            case GLFW_KEY_L:
+                showSlices = !showSlices;
+                std::cout << "Slices: " << (showSlices ? "ON" : "OFF") << std::endl;
+                break;
             case GLFW_KEY_W:
                 showWireframe = !showWireframe;
                 std::cout << "Wireframe: " << (showWireframe ? "ON" : "OFF") << std::endl;
                 break;
+            case GLFW_KEY_F:
+                // Without a normal stream flat shading is the only option
+                flatShading = !flatShading || !normalStream;
+                std::cout << "Flat shading: " << (flatShading ? "ON" : "OFF") << std::endl;
+                break;
+            case GLFW_KEY_E:
+                showEdges = !showEdges;
+                std::cout << "Edges: " << (showEdges ? "ON" : "OFF") << std::endl;
+                break;
+            case GLFW_KEY_M:
+                shadingMode = (shadingMode + 1) % shadingModeCount;
+                std::cout << "Shading: " << shadingModes[shadingMode].name << std::endl;
+                break;
+            case GLFW_KEY_D:
+                debugViewMode = (debugViewMode + 1) % debugViewModeCount;
+                std::cout << "Debug view: " << debugViewModes[debugViewMode].name;
+                if (debugViewMode != 0) {
+                    std::cout << " (" << debugViewModes[debugViewMode].legend << ")";
+                }
+                if (debugViewMode == 3 && lodEnabled) {
+                    std::cout << ", in cluster order of the LOD hierarchy";
+                }
+                std::cout << std::endl;
+                break;
             case GLFW_KEY_ESCAPE:
                 glfwSetWindowShouldClose(window, true);
                 break;
@@ -561,6 +8131,25 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
+// Creates the viewer window, or with `share` a hidden window whose context shares objects
+// with it
+GLFWwindow* createWindow(int major, int minor, GLFWwindow* share) {
+    // Configure GLFW
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Background compiles and thumbnail runs only need a context
+    if (share != NULL || !thumbnailDirectory.empty()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        return glfwCreateWindow(1, 1, "OBJ Viewer", NULL, share);
+    }
+    glfwWindowHint(GLFW_SAMPLES, 8); // Enable high-quality anti-aliasing
+    glfwWindowHint(GLFW_STENCIL_BITS, 8); // Section caps
+
+    return glfwCreateWindow(1200, 800, "OBJ Viewer", NULL, NULL);
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }